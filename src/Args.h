@@ -15,12 +15,24 @@ struct Args {
     std::string srcBlendshapeDir;
     std::string srcPoseDir;
     std::string srcWeightsPath;
+    std::string srcCachePath;
     std::string tgtNeutralPath;
     std::string tgtPoseDir;
     std::string tgtWeightsPath;
     std::string vertexMaskPath;
     std::string outputPath;
     std::string debugPath;
+    std::string cacheDir;
+    bool binary;
+    bool reorder;
+
+    bool single;
+    bool singleVertex;
+
+    int regionRings;
+
+    bool compactMask;
+    size_t ioThreads;
 
     bool read(int argc, char *argv[]) {
         cxxopts::Options options("ebfr", "Generate a facial blendshape rig from example poses");
@@ -29,6 +41,7 @@ struct Args {
                 ("source-blendshapes", "Path to the directory containing the source blendshape", cxxopts::value<std::string>())
                 ("source-poses", "Path to the directory containing the source pose mesh files", cxxopts::value<std::string>())
                 ("source-weights", "Path to the source pose-weights file", cxxopts::value<std::string>())
+                ("source-cache", "Path to a binary cache (.ebfrc) of the source rig, written if missing or out of date", cxxopts::value<std::string>())
 
                 ("target-neutral", "Path to the target neutral mesh file", cxxopts::value<std::string>())
                 ("target-poses", "Path to the directory containing the target pose mesh files", cxxopts::value<std::string>())
@@ -37,7 +50,16 @@ struct Args {
                 ("vertex-mask", "Path to the vertex mask file", cxxopts::value<std::string>())
 
                 ("output", "Path to a directory to write the final target blendshapes", cxxopts::value<std::string>())
-                ("debug", "Path to a directory to save in-progress data (meshes, weights, etc.", cxxopts::value<std::string>());
+                ("debug", "Path to a directory to save in-progress data (meshes, weights, etc.", cxxopts::value<std::string>())
+                ("binary", "Also write the final results as binary arrays and a glTF (.glb); debug snapshots are written as binary arrays only", cxxopts::value<bool>()->default_value("false"))
+                ("cache-dir", "Path to a directory to cache the source-side precomputation (gradients, M*, W) and vertex solver factorizations across runs", cxxopts::value<std::string>())
+
+                ("io-threads", "Maximum number of meshes read concurrently, per rig", cxxopts::value<int>()->default_value("8"))
+                ("reorder", "Reorder vertices and faces along a space-filling curve for cache locality while solving; final outputs keep the original order, debug snapshots don't", cxxopts::value<bool>()->default_value("false"))
+                ("single", "Run the gradient and weights solves and the pose evaluation in single precision", cxxopts::value<bool>()->default_value("false"))
+                ("single-vertex", "Factorize the vertex solve in single precision, refining the solution in double", cxxopts::value<bool>()->default_value("false"))
+                ("region-rings", "Solve each blendshape's vertices only around the region that moves in the source, grown by this many rings (-1 solves the whole mesh)", cxxopts::value<int>()->default_value("-1"))
+                ("compact-mask", "Run every stage on the vertex mask's submesh only, with the mask's border pinned to the neutral", cxxopts::value<bool>()->default_value("false"));
 
         try {
             auto result = options.parse(argc, argv);
@@ -59,9 +81,25 @@ struct Args {
             vertexMaskPath = result["vertex-mask"].as<std::string>();
             outputPath = result["output"].as<std::string>();
 
+            if (result.count("source-cache")) {
+                srcCachePath = result["source-cache"].as<std::string>();
+            }
+
             if (result.count("debug")) {
                 debugPath = result["debug"].as<std::string>();
             }
+
+            if (result.count("cache-dir")) {
+                cacheDir = result["cache-dir"].as<std::string>();
+            }
+
+            binary = result["binary"].as<bool>();
+            reorder = result["reorder"].as<bool>();
+            single = result["single"].as<bool>();
+            singleVertex = result["single-vertex"].as<bool>();
+            regionRings = result["region-rings"].as<int>();
+            compactMask = result["compact-mask"].as<bool>();
+            ioThreads = (size_t) std::max(1, result["io-threads"].as<int>());
         }
         catch (const cxxopts::OptionException &e) {
             std::cout << "error parsing options: " << e.what() << std::endl;
@@ -0,0 +1,238 @@
+//
+//  animate.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <iostream>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "shared/FS.h"
+#include "shared/CSV.h"
+#include "shared/Endian.h"
+#include "shared/Parallel.h"
+
+#include "ebfr/Rig.h"
+
+#include <cxxopts.hpp>
+
+// Streaming binary animation
+// Header: "EBFA", version, # of vertices, # of faces, # of frames (uint32, little-endian)
+// Faces: # of faces x 3 int32 vertex indices
+// Frames: # of frames x # of vertices x 3 float32 positions
+class AnimationWriter {
+public:
+    bool open(const std::string &path, const Mesh &mesh) {
+        _file.open(path, std::ios::binary);
+
+        if (!_file.is_open())
+            return false;
+
+        _numFrames = 0;
+
+        _buffer.clear();
+
+        AppendLE(_buffer, (uint32_t) 0x41464245); // EBFA
+        AppendLE(_buffer, (uint32_t) 1);
+        AppendLE(_buffer, (uint32_t) mesh.n_vertices());
+        AppendLE(_buffer, (uint32_t) mesh.n_faces());
+        AppendLE(_buffer, (uint32_t) 0);
+
+        Mesh::VertexHandle vertices[3];
+
+        for (auto faceIter = mesh.faces_begin(), faceEnd = mesh.faces_end(); faceIter != faceEnd; faceIter++) {
+            FaceVertices(mesh, *faceIter, vertices);
+
+            for (auto &v : vertices) {
+                AppendLE(_buffer, (int32_t) v.idx());
+            }
+        }
+
+        _file.write(_buffer.data(), _buffer.size());
+
+        return _file.good();
+    }
+
+    bool write(const std::vector<float> &frames, size_t numFrames) {
+        _buffer.clear();
+        AppendLE(_buffer, frames.data(), frames.size());
+
+        _file.write(_buffer.data(), _buffer.size());
+
+        _numFrames += numFrames;
+
+        return _file.good();
+    }
+
+    bool close() {
+        _buffer.clear();
+        AppendLE(_buffer, (uint32_t) _numFrames);
+
+        _file.seekp(4 * sizeof(uint32_t));
+        _file.write(_buffer.data(), _buffer.size());
+
+        _file.close();
+
+        return !_file.fail();
+    }
+
+private:
+    std::ofstream _file;
+
+    // Values in file (little-endian) order
+    std::vector<char> _buffer;
+
+    size_t _numFrames;
+};
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("ebfr-animate", "Evaluate an animation (per-frame blendshape weights) on a rig");
+
+    options.add_options()
+            ("blendshapes", "Path to the directory containing the rig's blendshapes", cxxopts::value<std::string>())
+            ("neutral", "Path to the neutral mesh, if not [blendshapes]/neutral.obj", cxxopts::value<std::string>())
+            ("weights", "Path to the per-frame weights file", cxxopts::value<std::string>())
+            ("output", "Path to a directory for an OBJ sequence, or to a .bin file", cxxopts::value<std::string>())
+            ("batch", "Number of frames evaluated per batch", cxxopts::value<int>()->default_value("256"));
+
+    std::string blendshapeDir;
+    std::string neutralPath;
+    std::string weightsPath;
+    std::string outputPath;
+    size_t batchSize;
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("blendshapes") || !result.count("weights") || !result.count("output")) {
+            std::cout << options.help() << std::endl;
+            exit(1);
+        }
+
+        blendshapeDir = result["blendshapes"].as<std::string>();
+        weightsPath = result["weights"].as<std::string>();
+        outputPath = result["output"].as<std::string>();
+        batchSize = std::max(1, result["batch"].as<int>());
+
+        if (result.count("neutral")) {
+            neutralPath = result["neutral"].as<std::string>();
+        }
+    }
+    catch (const cxxopts::OptionException &e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(1);
+    }
+
+    auto rig = MakeRig();
+
+    const auto loaded = neutralPath.empty()
+                        ? rig->loadBlendshapes(blendshapeDir)
+                        : rig->loadBlendshapes(blendshapeDir, neutralPath);
+
+    if (!loaded) {
+        std::cerr << "Failed to load rig " << blendshapeDir << std::endl;
+        return 1;
+    }
+
+    // Streamed a batch of rows at a time, so memory doesn't grow with the number of frames
+    PoseTable table;
+    if (!table.open(weightsPath)) {
+        std::cerr << "Failed to open Pose CSV " << weightsPath << std::endl;
+        return 1;
+    }
+
+    if (table.numWeights() + 1 != rig->numBlendshapes()) {
+        std::cerr << "Frames have " << table.numWeights() << " weights, expected " << (rig->numBlendshapes() - 1) << std::endl;
+        return 1;
+    }
+
+    const auto isBinary = HasExt(outputPath, "bin");
+
+    AnimationWriter writer;
+    if (isBinary && !writer.open(outputPath, *rig->neutral())) {
+        std::cerr << "Failed to open " << outputPath << std::endl;
+        return 1;
+    }
+
+    const auto numValues = rig->neutralPoints().size();
+
+    std::vector<float> frames;
+
+    // Evaluated points of each thread's segment, reused across batches (-1 is the calling thread)
+    std::vector<MatrixX> threadPoints(NumThreads(batchSize) + 1);
+
+    size_t numFrames = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Evaluates the table's current rows straight from its contiguous weights,
+    // returns false when the batch couldn't be written
+    auto evaluateBatch = [&]() {
+        const auto numRows = table.numRows();
+
+        std::atomic<size_t> numFailed(0);
+
+        if (isBinary) {
+            frames.resize(numRows * numValues);
+        }
+
+        ParallelSegments(numRows, [&](int threadId, size_t frameStart, size_t frameEnd) {
+            const auto numSegment = frameEnd - frameStart;
+
+            auto &points = threadPoints[threadId + 1];
+            rig->evaluate(table.weights(frameStart), numSegment, points);
+
+            if (isBinary) {
+                Eigen::Map<Eigen::MatrixXf>(frames.data() + (frameStart * numValues), numValues, numSegment) =
+                        points.cast<float>();
+            } else {
+                const auto &objWriter = rig->topology()->writer();
+
+                for (auto i = 0; i < numSegment; i++) {
+                    if (!objWriter.write(JoinPath(outputPath, table.name(frameStart + i) + ".obj"), points.col(i).data()))
+                        numFailed++;
+                }
+            }
+        });
+
+        if (isBinary && !writer.write(frames, numRows)) {
+            numFailed += numRows;
+        }
+
+        numFrames += numRows;
+
+        return numFailed == 0;
+    };
+
+    while (table.next(batchSize)) {
+        if (!evaluateBatch()) {
+            std::cerr << "Failed to write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+
+    if (table.failed()) {
+        std::cerr << "Failed to read Pose CSV " << weightsPath << std::endl;
+        return 1;
+    }
+
+    if (isBinary && !writer.close()) {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return 1;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    const auto seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout
+            << "Frames: " << numFrames << std::endl
+            << "Time: " << seconds << "s" << std::endl
+            << "FPS: " << (seconds > 0.0 ? numFrames / seconds : 0.0) << std::endl;
+
+    return 0;
+}
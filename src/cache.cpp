@@ -0,0 +1,88 @@
+//
+//  cache.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <iostream>
+
+#include "shared/Timing.h"
+
+#include "ebfr/Rig.h"
+#include "ebfr/RigCache.h"
+
+#include <cxxopts.hpp>
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("ebfr-cache", "Convert a rig into a binary rig cache (.ebfrc)");
+
+    options.add_options()
+            ("blendshapes", "Path to the directory containing the blendshape mesh files", cxxopts::value<std::string>())
+            ("poses", "Path to the directory containing the pose mesh files", cxxopts::value<std::string>())
+            ("weights", "Path to the pose-weights file", cxxopts::value<std::string>())
+            ("output", "Path to write the rig cache to", cxxopts::value<std::string>())
+            ("io-threads", "Maximum number of meshes read concurrently", cxxopts::value<int>()->default_value("8"));
+
+    std::string blendshapeDir;
+    std::string poseDir;
+    std::string weightsPath;
+    std::string outputPath;
+    size_t ioThreads;
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("blendshapes") || !result.count("poses") || !result.count("weights") || !result.count("output")) {
+            std::cout << options.help() << std::endl;
+            exit(1);
+        }
+
+        blendshapeDir = result["blendshapes"].as<std::string>();
+        poseDir = result["poses"].as<std::string>();
+        weightsPath = result["weights"].as<std::string>();
+        outputPath = result["output"].as<std::string>();
+        ioThreads = (size_t) std::max(1, result["io-threads"].as<int>());
+    }
+    catch (const cxxopts::OptionException &e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(1);
+    }
+
+    Rig rig;
+    rig.setIOThreads(ioThreads);
+
+    TIMER_START(Load);
+
+    if (!rig.load(blendshapeDir, poseDir, weightsPath, "", false)) {
+        std::cerr << "Failed to load rig" << std::endl;
+        return 1;
+    }
+
+    TIMER_END(Load);
+
+    TIMER_START(Write);
+
+    if (!WriteRigCache(outputPath, rig, RigCacheKey(blendshapeDir, poseDir, weightsPath)))
+        return 1;
+
+    TIMER_END(Write);
+
+    TIMER_START(Read);
+
+    // Round trip, so a bad cache is caught here rather than on first use
+    Rig cached;
+    if (!ReadRigCache(outputPath, cached)) {
+        return 1;
+    }
+
+    TIMER_END(Read);
+
+    std::cout
+            << "Blendshapes: " << cached.numBlendshapes() << std::endl
+            << "Poses: " << cached.numPoses() << std::endl
+            << "Vertices: " << cached.numVertices() << std::endl;
+
+    return 0;
+}
@@ -8,6 +8,7 @@
 
 #include "BlendshapeSolver.h"
 
+#include "../shared/Parallel.h"
 #include "../shared/SolverUtil.h"
 #include "../shared/Timing.h"
 
@@ -50,26 +51,53 @@ void BlendshapeSolver::setDebugPath(const std::string &path) {
     _weightsSolver.setDebugPath(path);
 }
 
+void BlendshapeSolver::setCacheDir(const std::string &path) {
+    _gradientSolver.setCacheDir(path);
+    _vertexSolver.setCacheDir(path);
+}
+
 void BlendshapeSolver::setMultithreaded(bool enable) {
     _gradientSolver.setMultithreaded(enable);
     _vertexSolver.setMultithreaded(enable);
     _weightsSolver.setMultithreaded(enable);
 }
 
+void BlendshapeSolver::setPrecision(Precision precision, Precision vertexPrecision) {
+    _gradientSolver.setPrecision(precision);
+    _vertexSolver.setPrecision(vertexPrecision);
+    _weightsSolver.setPrecision(precision);
+}
+
+void BlendshapeSolver::setRegionOfInfluence(bool enable, int rings) {
+    _vertexSolver.setRegionOfInfluence(enable, rings);
+}
+
+void BlendshapeSolver::setPinnedVertices(const std::vector<int> &vertices) {
+    _vertexSolver.setPinnedVertices(vertices);
+}
+
 bool BlendshapeSolver::setSource(RigPtr rig) {
-    _source = rig;
+    // Calculated (or restored from the cache) in init, once the target is set
+    return setSource(rig, std::make_shared<Gradients>());
+}
 
-    _sourceGradients = std::make_shared<Gradients>();
-    _sourceGradients->calculate(rig, false);
+bool BlendshapeSolver::setTarget(RigPtr rig) {
+    auto gradients = std::make_shared<Gradients>();
+    gradients->calculate(rig, true);
+
+    return setTarget(rig, gradients);
+}
+
+bool BlendshapeSolver::setSource(RigPtr rig, GradientsPtr gradients) {
+    _source = rig;
+    _sourceGradients = gradients;
 
     return _source != nullptr;
 }
 
-bool BlendshapeSolver::setTarget(RigPtr rig) {
+bool BlendshapeSolver::setTarget(RigPtr rig, GradientsPtr gradients) {
     _target = rig;
-
-    _targetGradients = std::make_shared<Gradients>();
-    _targetGradients->calculate(rig, true);
+    _targetGradients = gradients;
 
     return _target != nullptr;
 }
@@ -207,6 +235,13 @@ bool BlendshapeSolver::testWeights(int iter) {
 }
 
 void BlendshapeSolver::init() {
+    TIMER_START(SourceInit);
+
+    _gradientSolver.setSource(_source, _sourceGradients);
+    _gradientSolver.setTarget(_target, _targetGradients);
+    _gradientSolver.precompute();
+
+    TIMER_END(SourceInit);
 }
 
 void BlendshapeSolver::initGradient() {
@@ -250,27 +285,23 @@ void BlendshapeSolver::rebuildBlendshapes() {
 }
 
 void BlendshapeSolver::rebuildGradients() {
-    for (auto i = 0; i < _target->numBlendshapes(); i++) {
+    ParallelForEach(_target->numBlendshapes(), [this](size_t i) {
         //AddVertices(_target->neutral(), _target->blendshape(i).mesh(), 1, temp);
 
         // M_b
-        CalculateFrames(_target->blendshape(i).mesh(), _targetGradients->blendshapeM[i]);
-    }
+        CalculateFrames(_target->blendshape(i).mesh(), *_target->topology(), _targetGradients->blendshapeM[i]);
+    });
 }
 
 void BlendshapeSolver::rebuildPoses() {
-    for (auto pose = 0; pose < _target->numPoses(); pose++) {
-        const auto weights = _target->pose(pose).weights();
+    ParallelForEach(_target->numPoses(), [this](size_t pose) {
+        const auto &weights = _target->pose(pose).weights();
 
         auto poseMesh = _target->pose(pose).mesh();
 
-        CopyVertices(poseMesh, _target->neutral());
-
-        for (auto bs = 0; bs < _target->numBlendshapes(); bs++) {
-            AddVertices(poseMesh, _target->blendshape(bs).mesh(), weights[bs]);
-        }
+        _target->generatePose(weights, poseMesh);
 
-        CalculateFrames(poseMesh, _targetGradients->poseM[pose]);
-    }
+        CalculateFrames(poseMesh, *_target->topology(), _targetGradients->poseM[pose]);
+    });
 }
 
@@ -38,12 +38,32 @@ public:
 
     void setDebugPath(const std::string &path);
 
+    // Directory for caching the source-side precomputation and the vertex
+    // solver's factorizations across runs
+    void setCacheDir(const std::string &path);
+
     void setMultithreaded(bool enable);
 
+    // Precision of the gradient and weights solves, and separately of the
+    // vertex solve's factorization (refined in double when Single)
+    void setPrecision(Precision precision, Precision vertexPrecision = Precision::Double);
+
+    // Solve each blendshape's vertices over its region of influence, see VertexSolver
+    void setRegionOfInfluence(bool enable, int rings = 2);
+
+    // Target vertices the vertex solve keeps at the neutral
+    void setPinnedVertices(const std::vector<int> &vertices);
+
     bool setSource(RigPtr rig);
 
     bool setTarget(RigPtr rig);
 
+    // Use gradients that were already calculated for the rig, e.g. while it
+    // was being loaded. Empty source gradients are calculated in init.
+    bool setSource(RigPtr rig, GradientsPtr gradients);
+
+    bool setTarget(RigPtr rig, GradientsPtr gradients);
+
     RigPtr getSource() const;
 
     GradientsPtr getSourceGradients() const;
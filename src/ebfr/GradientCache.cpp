@@ -0,0 +1,172 @@
+//
+//  GradientCache.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "GradientCache.h"
+
+#include "../shared/FS.h"
+#include "../shared/Hash.h"
+#include "../shared/MappedFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+static uint64_t AlignOffset(uint64_t offset) {
+    return (offset + 63) / 64 * 64;
+}
+
+static uint64_t HashMesh(MeshPtr mesh, uint64_t hash) {
+    return Hash(mesh->points(), mesh->n_vertices() * sizeof(Mesh::Point), hash);
+}
+
+uint64_t GradientCacheKey(const Rig &source, const Rig &target, double k, double theta) {
+    auto hash = HashValue(GradientCacheVersion);
+
+    const auto &faces = source.topology()->faces();
+    hash = Hash(faces.data(), faces.size() * sizeof(int), hash);
+
+    for (const auto &blendshape : source.blendshapes()) {
+        hash = HashMesh(blendshape.mesh(), hash);
+    }
+
+    for (const auto &pose : source.poses()) {
+        hash = HashMesh(pose.mesh(), hash);
+    }
+
+    hash = HashMesh(target.neutral(), hash);
+
+    hash = HashValue(k, hash);
+    hash = HashValue(theta, hash);
+
+    return hash;
+}
+
+std::string GradientCachePath(const std::string &dirPath, uint64_t key) {
+    return JoinPath(dirPath, HashName(key) + ".ebfrg");
+}
+
+template<typename T>
+static void WriteBlock(char *dest, const Tensor<T> &values) {
+    std::memcpy(dest, values.data(), values.size() * sizeof(T));
+}
+
+template<typename T>
+static void ReadBlock(const char *src, size_t numShapes, size_t numFaces, Tensor<T> &values) {
+    values.resize(numShapes, numFaces);
+    std::memcpy(values.data(), src, values.size() * sizeof(T));
+}
+
+static bool IsFaceMajor(const Gradients &gradients, const Tensor<Matrix3x3> &mStar, const Tensor<double> &w) {
+    return gradients.blendshapeM.layout() == TensorLayout::FaceMajor &&
+           gradients.poseM.layout() == TensorLayout::FaceMajor &&
+           mStar.layout() == TensorLayout::FaceMajor &&
+           w.layout() == TensorLayout::FaceMajor;
+}
+
+bool WriteGradientCache(const std::string &path, uint64_t key, const Gradients &gradients,
+                        const Tensor<Matrix3x3> &mStar, const Tensor<double> &w) {
+    if (!IsFaceMajor(gradients, mStar, w)) {
+        std::cerr << "Gradient cache requires face-major tensors" << std::endl;
+        return false;
+    }
+
+    const auto numFaces = gradients.blendshapeMInv.numFaces();
+    const auto numBS = gradients.blendshapeM.numShapes();
+    const auto numPoses = gradients.poseM.numShapes();
+
+    const auto mSize = numFaces * sizeof(Matrix3x3);
+
+    GradientCacheHeader header = {};
+    header.magic = GradientCacheMagic;
+    header.version = GradientCacheVersion;
+    header.key = key;
+    header.numFaces = numFaces;
+    header.numBlendshapes = numBS;
+    header.numPoses = numPoses;
+
+    header.blendshapeMOffset = AlignOffset(sizeof(GradientCacheHeader));
+    header.blendshapeMInvOffset = AlignOffset(header.blendshapeMOffset + numBS * mSize);
+    header.poseMOffset = AlignOffset(header.blendshapeMInvOffset + mSize);
+    header.mStarOffset = AlignOffset(header.poseMOffset + numPoses * mSize);
+    header.wOffset = AlignOffset(header.mStarOffset + numBS * mSize);
+    header.size = header.wOffset + numBS * numFaces * sizeof(double);
+
+    std::vector<char> buffer(header.size, 0);
+
+    WriteBlock(buffer.data() + header.blendshapeMOffset, gradients.blendshapeM);
+    WriteBlock(buffer.data() + header.blendshapeMInvOffset, gradients.blendshapeMInv);
+    WriteBlock(buffer.data() + header.poseMOffset, gradients.poseM);
+    WriteBlock(buffer.data() + header.mStarOffset, mStar);
+    WriteBlock(buffer.data() + header.wOffset, w);
+
+    header.contentHash = Hash(buffer.data() + sizeof(GradientCacheHeader), buffer.size() - sizeof(GradientCacheHeader));
+
+    std::memcpy(buffer.data(), &header, sizeof(GradientCacheHeader));
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open gradient cache " << path << std::endl;
+        return false;
+    }
+
+    file.write(buffer.data(), buffer.size());
+
+    if (!file.good()) {
+        std::cerr << "Failed to write gradient cache " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadGradientCache(const std::string &path, uint64_t key, Gradients &gradients,
+                       Tensor<Matrix3x3> &mStar, Tensor<double> &w) {
+    if (!IsFaceMajor(gradients, mStar, w)) {
+        std::cerr << "Gradient cache requires face-major tensors" << std::endl;
+        return false;
+    }
+
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open gradient cache " << path << std::endl;
+        return false;
+    }
+
+    if (file.size() < sizeof(GradientCacheHeader)) {
+        std::cerr << "Invalid gradient cache " << path << std::endl;
+        return false;
+    }
+
+    const auto &header = *(const GradientCacheHeader *) file.data();
+
+    if (header.magic != GradientCacheMagic || header.version != GradientCacheVersion || header.size != file.size()) {
+        std::cerr << "Invalid gradient cache " << path << std::endl;
+        return false;
+    }
+
+    if (header.key != key) {
+        std::cerr << "Gradient cache " << path << " does not match the rigs" << std::endl;
+        return false;
+    }
+
+    if (header.contentHash != Hash(file.data() + sizeof(GradientCacheHeader), file.size() - sizeof(GradientCacheHeader))) {
+        std::cerr << "Gradient cache " << path << " is corrupt" << std::endl;
+        return false;
+    }
+
+    const auto numFaces = header.numFaces;
+    const auto numBS = header.numBlendshapes;
+
+    ReadBlock(file.data() + header.blendshapeMOffset, numBS, numFaces, gradients.blendshapeM);
+    ReadBlock(file.data() + header.blendshapeMInvOffset, 1, numFaces, gradients.blendshapeMInv);
+    ReadBlock(file.data() + header.poseMOffset, header.numPoses, numFaces, gradients.poseM);
+    ReadBlock(file.data() + header.mStarOffset, numBS, numFaces, mStar);
+    ReadBlock(file.data() + header.wOffset, numBS, numFaces, w);
+
+    return true;
+}
@@ -0,0 +1,74 @@
+//
+//  GradientCache.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef GradientCache_hpp
+#define GradientCache_hpp
+
+#include "../shared/Matrix.h"
+#include "../shared/Tensor.h"
+
+#include "Rig.h"
+#include "Gradients.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Cache of the source-side precomputation (.ebfrg)
+//
+// The source gradients, M* and W only depend on the source rig, the target
+// neutral and the regularization constants (k, theta), so they can be reused
+// across runs retargeting the same template.
+//
+// Layout (native byte order), each block aligned to 64 bytes and face-major,
+// as the tensors are stored:
+//   GradientCacheHeader
+//   blendshapeM:    # of faces x # of blendshapes Matrix3x3
+//   blendshapeMInv: # of faces Matrix3x3 (neutral only)
+//   poseM:          # of faces x # of poses Matrix3x3
+//   M*:             # of faces x # of blendshapes Matrix3x3 (the neutral's are zero)
+//   W:              # of faces x # of blendshapes float64
+
+const uint32_t GradientCacheMagic = 0x47464245; // EBFG
+const uint32_t GradientCacheVersion = 2;
+
+struct GradientCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    uint64_t key;
+
+    // Hash of everything following the header
+    uint64_t contentHash;
+
+    uint64_t numFaces;
+    uint64_t numBlendshapes;
+    uint64_t numPoses;
+
+    uint64_t blendshapeMOffset;
+    uint64_t blendshapeMInvOffset;
+    uint64_t poseMOffset;
+    uint64_t mStarOffset;
+    uint64_t wOffset;
+
+    uint64_t size;
+};
+
+// Hash of the source rig's geometry, the target neutral and the regularization constants
+uint64_t GradientCacheKey(const Rig &source, const Rig &target, double k, double theta);
+
+// File for the key, within the cache directory
+std::string GradientCachePath(const std::string &dirPath, uint64_t key);
+
+bool WriteGradientCache(const std::string &path, uint64_t key, const Gradients &gradients,
+                        const Tensor<Matrix3x3> &mStar, const Tensor<double> &w);
+
+bool ReadGradientCache(const std::string &path, uint64_t key, Gradients &gradients,
+                       Tensor<Matrix3x3> &mStar, Tensor<double> &w);
+
+#endif /* GradientCache_hpp */
@@ -7,8 +7,13 @@
 //
 
 #include "GradientSolver.h"
+#include "GradientCache.h"
 
-#include <thread>
+#include "../shared/Dispatch.h"
+#include "../shared/FS.h"
+#include "../shared/Parallel.h"
+
+#include <algorithm>
 #include <mutex>
 
 GradientSolver::GradientSolver()
@@ -19,6 +24,7 @@ GradientSolver::GradientSolver()
 , _regK(0.1)
 , _regTheta(2)
 , _beta(0.5) // -> 0.1
+, _kernelSize(Eigen::Dynamic)
 {
     setMultithreaded(true);
 }
@@ -32,9 +38,96 @@ void GradientSolver::setBlendshapeSolveConsts(const ParameterD &beta) {
     _beta = beta;
 }
 
-void GradientSolver::init() {
+void GradientSolver::precompute() {
+    uint64_t key = 0;
+    std::string cachePath;
+
+    if (!_cacheDir.empty()) {
+        key = GradientCacheKey(*_source, *_target, _regK(_iteration), _regTheta(_iteration));
+        cachePath = GradientCachePath(_cacheDir, key);
+
+        if (Exists(cachePath) && ReadGradientCache(cachePath, key, *_sourceGradients, _mStar, _w)) {
+            std::cout << "Read source precomputation from " << cachePath << std::endl;
+            return;
+        }
+    }
+
+    if (_sourceGradients->blendshapeM.empty()) {
+        _sourceGradients->calculate(_source, false);
+    }
+
     calculateMStars();
     calculateWs();
+
+    if (!cachePath.empty() && WriteGradientCache(cachePath, key, *_sourceGradients, _mStar, _w)) {
+        std::cout << "Wrote source precomputation to " << cachePath << std::endl;
+    }
+}
+
+void GradientSolver::init() {
+    if (_mStar.empty()) {
+        precompute();
+    }
+
+    classifyFaces();
+}
+
+void GradientSolver::classifyFaces() {
+    const auto numBS = _target->numBlendshapes();
+    const auto numFitPoses = _source->numPoses();
+
+    size_t numTrivial = 0;
+    size_t numFit = 0;
+    size_t numReg = 0;
+
+    _activeFaces.clear();
+
+    for (auto faceIndex = 0; faceIndex < _source->numFaces(); faceIndex++) {
+        const Index face = _source->face(faceIndex);
+
+        const auto &n = _targetGradients->blendshapeM(0, face);
+
+        // Active-fit: the face moves in some pose
+        auto isActive = false;
+
+        for (auto pose = 0; pose < numFitPoses && !isActive; pose++) {
+            isActive = _targetGradients->poseM(pose, face) != n;
+        }
+
+        if (isActive) {
+            _activeFaces.push_back(face);
+            numFit++;
+            continue;
+        }
+
+        // Active-reg: the face only moves in the source blendshapes
+        const auto faceMStar = _mStar.face(face);
+
+        for (auto bs = 1; bs < numBS && !isActive; bs++) {
+            isActive = faceMStar[bs] != Matrix3x3::Zero();
+        }
+
+        if (isActive) {
+            _activeFaces.push_back(face);
+            numReg++;
+            continue;
+        }
+
+        // Trivial: both sides of the system are zero, and so is the solution
+        auto faceMs = _targetGradients->blendshapeM.face(face);
+
+        for (auto bs = 1; bs < numBS; bs++) {
+            faceMs[bs].setZero();
+        }
+
+        numTrivial++;
+    }
+
+    std::cout
+            << "Gradient Faces: "
+            << numFit << " Active-Fit, "
+            << numReg << " Active-Reg, "
+            << numTrivial << " Trivial" << std::endl;
 }
 
 bool GradientSolver::solve(int iter) {
@@ -50,6 +143,8 @@ bool GradientSolver::solve(int iter) {
 
     _betaIter = _beta(_iteration);
 
+    findActiveColumns();
+
     std::mutex logMutex;
 
     auto solverOp =
@@ -61,52 +156,9 @@ bool GradientSolver::solve(int iter) {
                     logMutex.unlock();
                 }
 
-                const auto rows = (_source->numPoses() * _mSize) +
-                                  (_source->numPoses() * (_source->numBlendshapes() - 1) * _mSize);
-                const auto cols = _target->numBlendshapes() * _mSize;
-
-                TripletList a;
-                SparseMatrix A(rows, cols);
-
-                MatrixX c(rows, 1);
-                MatrixX x;
-
-                a.clear();
-                c.setZero();
-
-                Index faceIndex = faceStart;
-                Index numFaces = 0;
-
-                Eigen::LLT<MatrixX> solver;
-
-                while (true) {
-                    if (faceIndex >= faceEnd)
-                        break;
-
-                    Index face = _source->face(faceIndex);
-
-                    a.clear();
-                    c.setZero();
-
-                    appendGradientFit(face, a, c);
-                    appendGradientRegularization(face, a, c);
-
-                    A.setFromTriplets(a.begin(), a.end());
-                    A.makeCompressed();
-
-                    const auto At = A.transpose();
-
-                    solver.compute(At * A);
-                    if (!checkSolverError(solver.info()))
-                        break;
-
-                    x = solver.solve(At * c);
-
-                    copyBlendshapeMTo(x, _targetGradients->blendshapeM, face);
-
-                    faceIndex++;
-                    numFaces++;
-                }
+                const auto numFaces = _precision == Precision::Single
+                                      ? solveFaces<float>(faceStart, faceEnd)
+                                      : solveFaces<double>(faceStart, faceEnd);
 
                 if (_debug && threadId >= 0) {
                     logMutex.lock();
@@ -115,56 +167,75 @@ bool GradientSolver::solve(int iter) {
                 }
             };
 
-    if (_useMultithreaded) {
-        std::vector<std::thread> pool;
+    ParallelSegments(_activeFaces.size(), solverOp, _useMultithreaded ? 0 : 1);
 
-        const auto numThreads = std::thread::hardware_concurrency();
-        const auto size = _source->numFaces();
-        const auto segmentSize = (size / numThreads) + 1;
-        auto segmentStart = 0;
+    return true;
+}
 
-        for (auto i = 0; i < numThreads; i++) {
-            pool.push_back(
-                    std::thread(
-                            solverOp, i,
-                            segmentStart,
-                            std::min(segmentStart + segmentSize, size)
-                    )
-            );
+void GradientSolver::findActiveColumns() {
+    _systemColumns.clear();
+    _inactiveColumns.clear();
 
-            segmentStart += segmentSize;
-        }
+    // The neutral's column stays in the coupled system, it has no regularization
+    _systemColumns.push_back(0);
 
-        for (auto &thread : pool) {
-            thread.join();
+    for (auto bs = 1; bs < _target->numBlendshapes(); bs++) {
+        auto isActive = false;
+
+        for (auto pose = 0; pose < _source->numPoses() && !isActive; pose++) {
+            isActive = _target->weight(pose, bs) != 0.0;
         }
-    } else {
-        solverOp(-1, 0, _target->numFaces());
+
+        (isActive ? _systemColumns : _inactiveColumns).push_back(bs);
     }
 
-    return true;
+    const auto numActive = _systemColumns.size();
+
+    // Pad the system with inactive columns up to the next fixed-size kernel.
+    // They have no fit rows, so they stay decoupled and solve to M* (or zero).
+    const auto numColumns = PaddedBlendshapes(numActive, _target->numBlendshapes());
+
+    if (numColumns > numActive) {
+        const auto padding = _inactiveColumns.begin() + (numColumns - numActive);
+
+        _systemColumns.insert(_systemColumns.end(), _inactiveColumns.begin(), padding);
+        _inactiveColumns.erase(_inactiveColumns.begin(), padding);
+
+        std::sort(_systemColumns.begin(), _systemColumns.end());
+    }
+
+    _kernelSize = DispatchBlendshapes(_systemColumns.size(), [](auto numColumns) {
+        return (int) decltype(numColumns)::value;
+    });
+
+    std::cout << "\tActive Blendshapes: " << numActive - 1 << " / " << _target->numBlendshapes() - 1 << std::endl;
+    std::cout << "\tSystem Columns: " << _systemColumns.size()
+              << (_kernelSize == Eigen::Dynamic ? " (dynamic)" : " (fixed)") << std::endl;
 }
 
 void GradientSolver::calculateMStars() {
     const auto numFaces = _source->numFaces(true);
 
-    _mStar.resize(_source->numBlendshapes());
+    _mStar.resize(_source->numBlendshapes(), numFaces);
 
-    const auto &s0 = _sourceGradients->blendshapeM[0];
-    const auto &s0Inv = _sourceGradients->blendshapeMInv[0];
+    const auto &s = _sourceGradients->blendshapeM;
+    const auto &s0Inv = _sourceGradients->blendshapeMInv;
 
-    const auto &t0 = _targetGradients->blendshapeM[0];
+    const auto &t = _targetGradients->blendshapeM;
 
-    for (auto bs = 1; bs < _source->numBlendshapes(); bs++) {
-        auto &mStar = _mStar[bs];
+    for (auto face = 0; face < numFaces; face++) {
+        const auto &s0 = s(0, face);
+        const auto &t0 = t(0, face);
 
-        mStar.resize(numFaces);
+        for (auto bs = 1; bs < _source->numBlendshapes(); bs++) {
+            const auto &si = s(bs, face);
 
-        const auto &si = _sourceGradients->blendshapeM[bs];
-
-        for (auto face = 0; face < numFaces; face++) {
-            const auto m = (((s0[face] + si[face]) * s0Inv[face]) * t0[face]) - t0[face];
-            mStar[face] = m;
+            // Exactly zero (rather than rounding noise) where the shape doesn't deform the face
+            if (si == Matrix3x3::Zero()) {
+                _mStar(bs, face).setZero();
+            } else {
+                _mStar(bs, face) = (((s0 + si) * s0Inv(0, face)) * t0) - t0;
+            }
         }
     }
 }
@@ -172,141 +243,126 @@ void GradientSolver::calculateMStars() {
 void GradientSolver::calculateWs() {
     const auto numFaces = _source->numFaces(true);
 
-    _w.resize(_source->numBlendshapes());
+    _w.resize(_source->numBlendshapes(), numFaces);
 
     const auto k = _regK(_iteration);
     const auto t = _regTheta(_iteration);
 
-    for (auto bs = 0; bs < _source->numBlendshapes(); bs++) {
-        const auto &blendshapeM = _sourceGradients->blendshapeM[bs];
-
-        auto &blendshapeW = _w[bs];
-        blendshapeW.resize(numFaces);
+    const auto &blendshapeM = _sourceGradients->blendshapeM;
 
-        for (auto face = 0; face < numFaces; face++) {
-            const auto &mA = blendshapeM[face];
-            const auto mAf = mA.norm();
+    for (auto face = 0; face < numFaces; face++) {
+        for (auto bs = 0; bs < _source->numBlendshapes(); bs++) {
+            const auto mAf = blendshapeM(bs, face).norm();
 
-            auto &w = blendshapeW[face];
-
-            w = std::pow((1 + mAf) / (k + mAf), t);
+            _w(bs, face) = std::pow((1 + mAf) / (k + mAf), t);
         }
     }
 }
 
-void GradientSolver::appendGradientFit(Index face, TripletList &a, MatrixX &c) const {
-    appendGradientFitWeights(face, a);
-    appendGradientFit(face, c);
+template<typename Scalar>
+size_t GradientSolver::solveFaces(size_t faceStart, size_t faceEnd) const {
+    return DispatchBlendshapes(_systemColumns.size(), [&](auto numColumns) {
+        return solveFaces<Scalar, decltype(numColumns)::value>(faceStart, faceEnd);
+    });
 }
 
-void GradientSolver::appendGradientFitWeights(Index face, TripletList &a) const {
-    for (auto pose = 0; pose < _source->numPoses(); pose++) {
-        const auto row = rowIndex(pose, false);
-
-        for (auto bs = 0; bs < _target->numBlendshapes(); bs++) {
-            const auto weight = _target->weight(pose, bs);
-
-            if (weight == 0.0)
-                continue;
-
-            const auto col = colIndex(bs, false);
-
-            for (auto i = 0; i < _mSize; i++) {
-                a.emplace_back(row + i, col + i, weight);
-            }
+template<typename Scalar, int NumColumns>
+size_t GradientSolver::solveFaces(size_t faceStart, size_t faceEnd) const {
+    constexpr auto KSize = FixedSquareSize<Scalar, NumColumns>();
+
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, NumColumns> MatrixW;
+    typedef Eigen::Matrix<Scalar, KSize, KSize> MatrixK;
+    typedef Eigen::Matrix<Scalar, Eigen::Dynamic, Matrix9x1::RowsAtCompileTime> MatrixFit;
+    typedef Eigen::Matrix<Scalar, NumColumns, Matrix9x1::RowsAtCompileTime> MatrixX9;
+    typedef Eigen::Map<const Matrix9x1> MapM;
+
+    const auto numColumns = _systemColumns.size();
+    const auto numFitPoses = _source->numPoses();
+    const auto numRegPoses = _target->numPoses();
+
+    // Every row of A scales an identity block, so A^T A = K (x) I9 and the
+    // 9C system (C system columns) splits into one CxC solve with 9
+    // right-hand sides. The fit part of K only depends on the pose weights
+    // and is shared by all faces.
+    MatrixW weights(numFitPoses, numColumns);
+
+    for (auto pose = 0; pose < numFitPoses; pose++) {
+        for (auto i = 0; i < numColumns; i++) {
+            weights(pose, i) = (Scalar) _target->weight(pose, _systemColumns[i]);
         }
     }
-}
 
-void GradientSolver::appendGradientFit(Index face, MatrixX &c) const {
-    for (auto pose = 0; pose < _source->numPoses(); pose++) {
-        appendGradientFit(face, pose, c);
-    }
-}
+    const MatrixK kFit = weights.transpose() * weights;
 
-void GradientSolver::appendGradientFit(Index face, Index pose, MatrixX &c) const {
-    const auto &s = _targetGradients->poseM[pose][face];
-    const auto &n = _targetGradients->blendshapeM[0][face];
+    MatrixK k(numColumns, numColumns);
+    MatrixFit fit(numFitPoses, _mSize);
+    MatrixX9 x(numColumns, _mSize);
 
-    const auto row = rowIndex(pose, false);
+    Eigen::LLT<MatrixK> solver(numColumns);
 
-    for (auto i = 0; i < _mCols; i++) {
-        for (auto j = 0; j < _mRows; j++) {
-            const auto offset = (i * _mRows) + j;
+    size_t numFaces = 0;
 
-            c(row + offset, 0) = s(j, i) - n(j, i);
-        }
-    }
-}
+    for (auto faceIndex = faceStart; faceIndex < faceEnd; faceIndex++) {
+        const Index face = _activeFaces[faceIndex];
 
-void GradientSolver::appendGradientRegularization(Index face, TripletList &a, MatrixX &c) const {
-    for (auto pose = 0; pose < _target->numPoses(); pose++) {
-        appendGradientRegularization(face, pose, a, c);
-    }
-}
+        const auto &n = _targetGradients->blendshapeM(0, face);
 
-void GradientSolver::appendGradientRegularization(Index face, Index pose, TripletList &a, MatrixX &c) const {
-    for (Index bs = 1; bs < _target->numBlendshapes(); bs++) {
-        appendGradientRegularization(face, pose, bs, a, c);
-    }
-}
+        // Columns of (S_p - N), column-major as the original rows
+        for (auto pose = 0; pose < numFitPoses; pose++) {
+            const Matrix3x3 d = _targetGradients->poseM(pose, face) - n;
 
-void GradientSolver::appendGradientRegularization(Index face, Index pose, Index bs, TripletList &a, MatrixX &c) const {
-    //const Index row = rowIndex(pose, true);
-    const Index col = colIndex(bs, true);
+            fit.row(pose) = MapM(d.data()).transpose().template cast<Scalar>();
+        }
 
-    const Index row =
-            (_source->numPoses() * _mSize) +
-            (((_source->numBlendshapes() - 1) * _mSize * pose) + (_mSize * (bs - 1)));
+        x.noalias() = weights.transpose() * fit;
+        k = kFit;
 
-    const auto wbeta = _w[bs][face] * _betaIter;
+        const auto faceW = _w.face(face);
+        const auto faceMStar = _mStar.face(face);
 
-    if (wbeta == 0.0)
-        return;
+        // Regularization rows, wbeta * M^B_i = wbeta * M*_i, once per target pose
+        for (auto i = 1; i < numColumns; i++) {
+            const auto bs = _systemColumns[i];
+            const auto wbeta = faceW[bs] * _betaIter;
 
-    const auto &mStar = _mStar[bs][face];
+            if (wbeta == 0.0) {
+                // A padding column without regularization has an empty row, M = 0
+                if (k(i, i) == Scalar(0))
+                    k(i, i) = Scalar(1);
 
-    // M^B_i * wbeta
-    for (auto i = 0; i < _mSize; i++) {
-        a.emplace_back(row + i, col + i, wbeta);
-    }
+                continue;
+            }
 
-    for (auto i = 0; i < _mCols; i++) {
-        for (auto j = 0; j < _mRows; j++) {
-            const auto offset = (i * _mRows) + j; //index(j, i);
+            const auto reg = numRegPoses * wbeta * wbeta;
 
-            c(row + offset, 0) = wbeta * mStar(j, i);
+            k(i, i) += (Scalar) reg;
+            x.row(i) += (reg * MapM(faceMStar[bs].data()).transpose()).template cast<Scalar>();
         }
-    }
-}
 
-Index GradientSolver::rowIndex(Index pose, bool isReg) const {
-    if (isReg)
-        return (Index) (_source->numPoses() + pose) * _mSize;
+        solver.compute(k);
+        if (!checkSolverError(solver.info()))
+            break;
 
-    return (Index) (pose * _mSize);
-}
+        x = solver.solve(x);
 
-Index GradientSolver::colIndex(Index bs, bool isReg) const {
-    return (Index) (bs * _mSize);
-}
+        // Don't overwrite BS0/Neutral M
+        auto faceMs = _targetGradients->blendshapeM.face(face);
 
-Index GradientSolver::index(Index row, Index col) const {
-    return (row * _mCols) + col;
-}
-
-void GradientSolver::copyBlendshapeMTo(MatrixX &x, std::vector<std::vector<Matrix3x3>> &ms, Index face) const {
-    // Don't overwrite BS0/Neutral M
-    auto row = _mSize;
-
-    for (auto bs = 1; bs < _target->numBlendshapes(); bs++) {
-        auto &m = ms[bs][face];
+        for (auto i = 1; i < numColumns; i++) {
+            Eigen::Map<Matrix9x1>(faceMs[_systemColumns[i]].data()) = x.row(i).transpose().template cast<double>();
+        }
 
-        for (auto i = 0; i < _mCols; i++) {
-            for (auto j = 0; j < _mRows; j++) {
-                m(j, i) = x(row, 0);
-                row++;
+        // Inactive columns only have their regularization rows, minimized by M* itself
+        for (auto bs : _inactiveColumns) {
+            if (faceW[bs] * _betaIter == 0.0) {
+                faceMs[bs].setZero();
+            } else {
+                faceMs[bs] = faceMStar[bs];
             }
         }
+
+        numFaces++;
     }
+
+    return numFaces;
 }
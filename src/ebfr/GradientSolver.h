@@ -19,10 +19,27 @@ public:
 
     void setBlendshapeSolveConsts(const ParameterD &beta);
 
+    // Directory for the cached source-side precomputation, see GradientCache.h
+    void setCacheDir(const std::string &path) { _cacheDir = path; }
+
+    // Source gradients, M* and W. These only depend on the source rig, the
+    // target neutral and the regularization constants, so they're restored
+    // from the cache directory when possible (and written to it otherwise).
+    void precompute();
+
     virtual void init();
 
     virtual bool solve(int iter);
 
+    // Per-face regularization targets and weights, as used by the solve
+    const Tensor<Matrix3x3> &mStar() const { return _mStar; }
+
+    const Tensor<double> &w() const { return _w; }
+
+    // Blendshape count of the fixed-size kernel instance the last solve ran,
+    // Eigen::Dynamic when it had none, see Dispatch.h
+    int kernelSize() const { return _kernelSize; }
+
 private:
     typedef Matrix3x3 _Matrix;
 
@@ -36,37 +53,48 @@ private:
 
     double _betaIter;
 
-    std::vector<std::vector<double>> _w;
-
-    std::vector<std::vector<Matrix3x3>> _mStar;
-
-    void calculateMStars();
-
-    void calculateWs();
-
-    void appendGradientFit(Index face, TripletList &a, MatrixX &c) const;
-
-    void appendGradientFitWeights(Index face, TripletList &a) const;
+    std::string _cacheDir;
 
-    void appendGradientFit(Index face, MatrixX &c) const;
+    // Face-major, as the source gradients; M* has no neutral entries
+    Tensor<double> _w;
 
-    void appendGradientFit(Index face, Index pose, MatrixX &c) const;
+    Tensor<Matrix3x3> _mStar;
 
-    void appendGradientFit(Index face, Index pose, Index bs, MatrixX &c) const;
+    // Faces with a non-zero solution, see classifyFaces()
+    std::vector<Index> _activeFaces;
 
-    void appendGradientRegularization(Index face, TripletList &a, MatrixX &c) const;
+    // Columns of the coupled per-face system: the neutral, the blendshapes
+    // with a non-zero weight in some pose, and inactive blendshapes padding
+    // it to a fixed kernel size. The remaining inactive blendshapes are
+    // solved in closed form. See findActiveColumns().
+    std::vector<Index> _systemColumns;
+    std::vector<Index> _inactiveColumns;
 
-    void appendGradientRegularization(Index face, Index pose, TripletList &a, MatrixX &c) const;
+    int _kernelSize;
 
-    void appendGradientRegularization(Index face, Index pose, Index bs, TripletList &a, MatrixX &c) const;
-
-    Index rowIndex(Index pose, bool isReg) const;
-
-    Index colIndex(Index bs, bool isReg) const;
+    void calculateMStars();
 
-    Index index(Index row, Index col) const;
+    void calculateWs();
 
-    void copyBlendshapeMTo(MatrixX &x, std::vector<std::vector<Matrix3x3>> &ms, Index face) const;
+    // Splits the (masked) faces into active-fit ones, which move in some
+    // target pose, active-reg ones, which only move in the source
+    // blendshapes (M* != 0), and trivial ones. Trivial faces have a zero
+    // solution, which is set here; only the active faces are solved.
+    void classifyFaces();
+
+    // Splits the blendshapes by their weights in the current iteration. An
+    // inactive blendshape has no fit rows, so its solution is M* (or zero
+    // without regularization). It's left out of the coupled system unless
+    // needed to pad the system to the next fixed-size kernel.
+    void findActiveColumns();
+
+    // Solves the active faces [faceStart, faceEnd) in the given precision, returns the number solved.
+    // NumColumns is the number of system columns for the fixed-size instances, see Dispatch.h.
+    template<typename Scalar, int NumColumns>
+    size_t solveFaces(size_t faceStart, size_t faceEnd) const;
+
+    template<typename Scalar>
+    size_t solveFaces(size_t faceStart, size_t faceEnd) const;
 };
 
 #endif /* GradientSolver_hpp */
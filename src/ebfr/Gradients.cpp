@@ -8,41 +8,55 @@
 
 #include "Gradients.h"
 
+#include "../shared/Parallel.h"
 #include "../shared/SolverUtil.h"
 
+#include <iostream>
+
 void Gradients::calculate(RigPtr rig, bool isTarget) {
     const auto &poses = rig->poses();
-    const auto &blendshapes = rig->blendshapes();
 
     //// Calculate Frames - M_(A_i)
-    poseM.resize(poses.size());
+    resizePoses(poses.size(), rig->numFaces(true));
 
-    for (auto i = 0; i < poses.size(); i++)
-        CalculateFrames(poses[i].mesh(), poseM[i]);
+    ParallelForEach(poses.size(), [&](size_t i) {
+        calculatePose(i, poses[i].mesh(), *rig->topology());
+    });
 
-    blendshapeM.resize(blendshapes.size());
+    calculateBlendshapes(rig, isTarget);
+}
 
+void Gradients::calculateBlendshapes(RigPtr rig, bool isTarget) {
     auto neutral = rig->neutral();
+    const auto &topology = *rig->topology();
+
+    blendshapeM.resize(rig->numBlendshapes(), neutral->n_faces());
+    blendshapeMInv.resize(1, neutral->n_faces());
 
-    for (auto bs = 0; bs < rig->numBlendshapes(); bs++) {
+    ParallelForEach(rig->numBlendshapes(), [&](size_t bs) {
         const auto mesh = rig->blendshape(bs).mesh();
-        auto &m = blendshapeM[bs];
+        auto m = blendshapeM[bs];
 
         if (bs == 0) {
-            CalculateFrames(mesh, m);
+            const auto numDegenerate = CalculateFrames(mesh, topology, m, blendshapeMInv[0]);
+
+            if (numDegenerate > 0) {
+                std::cerr << "Warning: " << numDegenerate << " degenerate faces in the neutral" << std::endl;
+            }
         } else {
             if (isTarget) {
                 GenerateEmptyFrames(neutral, m);
             } else {
-                CalculateFrames(mesh, m);
+                CalculateFrames(mesh, topology, m);
             }
         }
-    }
+    });
+}
 
-    blendshapeMInv.resize(1);
-    blendshapeMInv[0].resize(blendshapeM[0].size());
+void Gradients::resizePoses(size_t numPoses, size_t numFaces) {
+    poseM.resize(numPoses, numFaces);
+}
 
-    for (auto i = 0; i < blendshapeM[0].size(); i++) {
-        blendshapeMInv[0][i] = blendshapeM[0][i].inverse();
-    }
-}
\ No newline at end of file
+void Gradients::calculatePose(size_t pose, MeshPtr mesh, const Topology &topology) {
+    CalculateFrames(mesh, topology, poseM[pose]);
+}
@@ -10,20 +10,33 @@
 #define Gradients_hpp
 
 #include "../shared/Matrix.h"
+#include "../shared/Tensor.h"
 #include "Rig.h"
 
 #include <vector>
 
+// Frames are stored face-major, so the per-face gradient solve reads every
+// blendshape and pose of a face from one block; blendshapeM[bs] is a view of
+// one blendshape's faces for the per-blendshape vertex solve.
 class Gradients {
 public:
-    std::vector<std::vector<Matrix3x3>> blendshapeM;
-    std::vector<std::vector<Matrix3x3>> blendshapeMInv;
+    Tensor<Matrix3x3> blendshapeM;
+    Tensor<Matrix3x3> blendshapeMInv;
 
     std::vector<std::vector<Matrix3x3>> blendshapeG;
 
-    std::vector<std::vector<Matrix3x3>> poseM;
+    Tensor<Matrix3x3> poseM;
 
     void calculate(RigPtr rig, bool isTarget);
+
+    // The parts of calculate, for computing the frames as the rig's meshes
+    // are loaded. Target blendshapes (other than the neutral) are empty.
+    void calculateBlendshapes(RigPtr rig, bool isTarget);
+
+    // Sizes poseM; calculatePose can then be called concurrently for different poses
+    void resizePoses(size_t numPoses, size_t numFaces);
+
+    void calculatePose(size_t pose, MeshPtr mesh, const Topology &topology);
 };
 
 typedef std::shared_ptr<Gradients> GradientsPtr;
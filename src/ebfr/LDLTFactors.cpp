@@ -0,0 +1,167 @@
+//
+//  LDLTFactors.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "LDLTFactors.h"
+
+#include "../shared/Hash.h"
+#include "../shared/MappedFile.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+LDLTFactors::LDLTFactors()
+: _l()
+, _d()
+, _p()
+, _pInv()
+{
+}
+
+void LDLTFactors::set(const Solver &solver) {
+    _l = solver.matrixL().nestedExpression();
+    _l.makeCompressed();
+
+    _d = solver.vectorD();
+
+    _p = solver.permutationP();
+    _pInv = solver.permutationPinv();
+}
+
+void LDLTFactors::solve(const MatrixX &b, MatrixX &x) const {
+    // Same steps as SimplicialLDLT::solve
+    x = _p * b;
+
+    _l.triangularView<Eigen::UnitLower>().solveInPlace(x);
+
+    x = _d.asDiagonal().inverse() * x;
+
+    _l.transpose().triangularView<Eigen::UnitUpper>().solveInPlace(x);
+
+    x = _pInv * x;
+}
+
+bool LDLTFactors::write(const std::string &path, uint64_t key) const {
+    const auto size = (uint64_t) _d.size();
+    const auto nonZeros = (uint64_t) _l.nonZeros();
+
+    std::vector<char> buffer(sizeof(LDLTFactorsHeader) +
+                             (nonZeros + size) * sizeof(double) +
+                             (size + 1 + nonZeros + size) * sizeof(int));
+
+    auto dest = buffer.data() + sizeof(LDLTFactorsHeader);
+
+    auto append = [&dest](const void *src, size_t bytes) {
+        std::memcpy(dest, src, bytes);
+        dest += bytes;
+    };
+
+    append(_l.valuePtr(), nonZeros * sizeof(double));
+    append(_d.data(), size * sizeof(double));
+    append(_l.outerIndexPtr(), (size + 1) * sizeof(int));
+    append(_l.innerIndexPtr(), nonZeros * sizeof(int));
+    append(_p.indices().data(), size * sizeof(int));
+
+    LDLTFactorsHeader header = {};
+    header.magic = LDLTFactorsMagic;
+    header.version = LDLTFactorsVersion;
+    header.key = key;
+    header.contentHash = Hash(buffer.data() + sizeof(LDLTFactorsHeader), buffer.size() - sizeof(LDLTFactorsHeader));
+    header.size = size;
+    header.nonZeros = nonZeros;
+
+    std::memcpy(buffer.data(), &header, sizeof(LDLTFactorsHeader));
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open factor cache " << path << std::endl;
+        return false;
+    }
+
+    file.write(buffer.data(), buffer.size());
+
+    if (!file.good()) {
+        std::cerr << "Failed to write factor cache " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool LDLTFactors::read(const std::string &path, uint64_t key) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open factor cache " << path << std::endl;
+        return false;
+    }
+
+    if (file.size() < sizeof(LDLTFactorsHeader)) {
+        std::cerr << "Invalid factor cache " << path << std::endl;
+        return false;
+    }
+
+    LDLTFactorsHeader header;
+    std::memcpy(&header, file.data(), sizeof(LDLTFactorsHeader));
+
+    const auto size = header.size;
+    const auto nonZeros = header.nonZeros;
+
+    const auto expectedSize = sizeof(LDLTFactorsHeader) +
+                              (nonZeros + size) * sizeof(double) +
+                              (size + 1 + nonZeros + size) * sizeof(int);
+
+    if (header.magic != LDLTFactorsMagic || header.version != LDLTFactorsVersion || file.size() != expectedSize) {
+        std::cerr << "Invalid factor cache " << path << std::endl;
+        return false;
+    }
+
+    if (header.key != key) {
+        std::cerr << "Factor cache " << path << " does not match" << std::endl;
+        return false;
+    }
+
+    if (header.contentHash != Hash(file.data() + sizeof(LDLTFactorsHeader), file.size() - sizeof(LDLTFactorsHeader))) {
+        std::cerr << "Factor cache " << path << " is corrupt" << std::endl;
+        return false;
+    }
+
+    auto src = file.data() + sizeof(LDLTFactorsHeader);
+
+    auto take = [&src](void *dest, size_t bytes) {
+        std::memcpy(dest, src, bytes);
+        src += bytes;
+    };
+
+    _l.resize((Eigen::Index) size, (Eigen::Index) size);
+    _l.resizeNonZeros((Eigen::Index) nonZeros);
+    _d.resize((Eigen::Index) size);
+    _p.resize((Eigen::Index) size);
+
+    take(_l.valuePtr(), nonZeros * sizeof(double));
+    take(_d.data(), size * sizeof(double));
+    take(_l.outerIndexPtr(), (size + 1) * sizeof(int));
+    take(_l.innerIndexPtr(), nonZeros * sizeof(int));
+    take(_p.indices().data(), size * sizeof(int));
+
+    _pInv = _p.inverse();
+
+    return true;
+}
+
+uint64_t LDLTFactorsKey(const SparseMatrix &a) {
+    auto hash = HashValue(LDLTFactorsVersion);
+
+    hash = HashValue((int64_t) a.rows(), hash);
+    hash = HashValue((int64_t) a.cols(), hash);
+
+    hash = Hash(a.outerIndexPtr(), (a.outerSize() + 1) * sizeof(int), hash);
+    hash = Hash(a.innerIndexPtr(), a.nonZeros() * sizeof(int), hash);
+    hash = Hash(a.valuePtr(), a.nonZeros() * sizeof(double), hash);
+
+    return hash;
+}
@@ -0,0 +1,73 @@
+//
+//  LDLTFactors.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef LDLTFactors_hpp
+#define LDLTFactors_hpp
+
+#include "../shared/Matrix.h"
+
+#include <cstdint>
+#include <string>
+
+// The factors of a sparse LDLT decomposition, P A P^-1 = L D L^T, taken from
+// Eigen's SimplicialLDLT. They can be written to a cache file (.ebfrv) and
+// read back to solve with, without refactoring A.
+//
+// Layout (native byte order):
+//   LDLTFactorsHeader
+//   L values:      # of non-zeros float64 (strictly lower, column-major)
+//   D:             size float64
+//   L columns:     (size + 1) int32 column starts
+//   L rows:        # of non-zeros int32 row indices
+//   P:             size int32
+class LDLTFactors {
+public:
+    typedef Eigen::SimplicialLDLT<SparseMatrix> Solver;
+
+    LDLTFactors();
+
+    bool isValid() const { return _d.size() > 0; }
+
+    void set(const Solver &solver);
+
+    // x = P^-1 L^-T D^-1 L^-1 P b
+    void solve(const MatrixX &b, MatrixX &x) const;
+
+    bool write(const std::string &path, uint64_t key) const;
+
+    bool read(const std::string &path, uint64_t key);
+
+private:
+    SparseMatrix _l;
+
+    VectorX _d;
+
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> _p;
+    Eigen::PermutationMatrix<Eigen::Dynamic, Eigen::Dynamic, int> _pInv;
+};
+
+const uint32_t LDLTFactorsMagic = 0x56464245; // EBFV
+const uint32_t LDLTFactorsVersion = 1;
+
+struct LDLTFactorsHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    uint64_t key;
+
+    // Hash of everything following the header
+    uint64_t contentHash;
+
+    uint64_t size;
+    uint64_t nonZeros;
+};
+
+// Hash of the sparsity pattern and values of A (compressed)
+uint64_t LDLTFactorsKey(const SparseMatrix &a);
+
+#endif /* LDLTFactors_hpp */
@@ -0,0 +1,165 @@
+//
+//  QuantizedBlendshapes.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "QuantizedBlendshapes.h"
+
+typedef Eigen::Array<int16_t, Eigen::Dynamic, 1> ArrayXs;
+typedef Eigen::Array<Eigen::half, Eigen::Dynamic, 1> ArrayXh;
+
+QuantizedBlendshapes::QuantizedBlendshapes(Format format)
+: _format(format)
+, _numValues(0)
+{
+}
+
+void QuantizedBlendshapes::build(const Rig &rig) {
+    const auto &deltas = rig.deltas();
+    const auto numShapes = deltas.cols();
+
+    _numValues = deltas.rows();
+
+    _neutral = rig.neutralPoints().cast<float>();
+
+    _scale.resize(numShapes);
+    _offset.resize(numShapes);
+
+    _int16.clear();
+    _float16.clear();
+
+    if (_format == Int16) {
+        _int16.resize(_numValues * numShapes);
+    } else {
+        _float16.resize(_numValues * numShapes);
+    }
+
+    for (auto i = 0; i < numShapes; i++) {
+        const auto d = deltas.col(i);
+
+        const auto min = d.size() > 0 ? d.minCoeff() : 0.0;
+        const auto max = d.size() > 0 ? d.maxCoeff() : 0.0;
+
+        // int16: centre the range and map it to [-32767, 32767]
+        // float16: map to [-1, 1] without an offset, so that the precision is
+        // relative and unmoved (zero) vertices stay exactly zero
+        const auto offset = _format == Int16 ? (max + min) * 0.5 : 0.0;
+        const auto range = _format == Int16 ? (max - min) * 0.5 : std::max(-min, max);
+
+        auto scale = _format == Int16 ? range / 32767.0 : range;
+        if (scale == 0.0)
+            scale = 1.0;
+
+        _scale[i] = (float) scale;
+        _offset[i] = (float) offset;
+
+        const auto q = ((d.array() - offset) / scale).eval();
+
+        if (_format == Int16) {
+            Eigen::Map<ArrayXs>(_int16.data() + (i * _numValues), _numValues) =
+                    q.round().max(-32767.0).min(32767.0).cast<int16_t>();
+        } else {
+            Eigen::Map<ArrayXh>(_float16.data() + (i * _numValues), _numValues) =
+                    q.cast<Eigen::half>();
+        }
+    }
+}
+
+void QuantizedBlendshapes::evaluate(const Weights &weights, Eigen::VectorXf &points) const {
+    points = _neutral;
+
+    auto p = points.array();
+
+    for (auto i = 0; i < _scale.size(); i++) {
+        const auto w = (float) weights[i + 1];
+
+        if (w == 0.0f)
+            continue;
+
+        // w * (q * scale + offset) == a * q + b
+        const auto a = w * _scale[i];
+        const auto b = w * _offset[i];
+
+        if (_format == Int16) {
+            const Eigen::Map<const ArrayXs> q(_int16.data() + (i * _numValues), _numValues);
+
+            p += (q.cast<float>() * a) + b;
+        } else {
+            const Eigen::Map<const ArrayXh> q(_float16.data() + (i * _numValues), _numValues);
+
+            p += (q.cast<float>() * a) + b;
+        }
+    }
+}
+
+void QuantizedBlendshapes::dequantize(int bs, Eigen::VectorXf &deltas) const {
+    const auto i = bs - 1;
+
+    if (_format == Int16) {
+        const Eigen::Map<const ArrayXs> q(_int16.data() + (i * _numValues), _numValues);
+
+        deltas = ((q.cast<float>() * _scale[i]) + _offset[i]).matrix();
+    } else {
+        const Eigen::Map<const ArrayXh> q(_float16.data() + (i * _numValues), _numValues);
+
+        deltas = ((q.cast<float>() * _scale[i]) + _offset[i]).matrix();
+    }
+}
+
+QuantizedBlendshapes::Error QuantizedBlendshapes::error(const Rig &rig) const {
+    const auto &deltas = rig.deltas();
+
+    Error error{0.0, 0.0};
+
+    Eigen::VectorXf d;
+
+    for (auto bs = 1; bs < numBlendshapes(); bs++) {
+        dequantize(bs, d);
+
+        const auto diff = (d.cast<double>() - deltas.col(bs - 1)).eval();
+
+        if (diff.size() > 0)
+            error.max = std::max(error.max, diff.cwiseAbs().maxCoeff());
+
+        error.rms += diff.squaredNorm();
+    }
+
+    const auto count = (double) (_numValues * _scale.size());
+    if (count > 0)
+        error.rms = std::sqrt(error.rms / count);
+
+    return error;
+}
+
+QuantizedBlendshapes::Error QuantizedBlendshapes::error(const Rig &rig, const std::vector<Weights> &weights) const {
+    Error error{0.0, 0.0};
+
+    VectorX expected;
+    Eigen::VectorXf points;
+
+    for (const auto &w : weights) {
+        rig.evaluate(w, expected);
+        evaluate(w, points);
+
+        const auto diff = (points.cast<double>() - expected).eval();
+
+        if (diff.size() > 0)
+            error.max = std::max(error.max, diff.cwiseAbs().maxCoeff());
+
+        error.rms += diff.squaredNorm();
+    }
+
+    const auto count = (double) (_numValues * weights.size());
+    if (count > 0)
+        error.rms = std::sqrt(error.rms / count);
+
+    return error;
+}
+
+size_t QuantizedBlendshapes::sizeInBytes() const {
+    return (_int16.size() * sizeof(int16_t)) + (_float16.size() * sizeof(Eigen::half)) +
+           ((_scale.size() + _offset.size()) * sizeof(float));
+}
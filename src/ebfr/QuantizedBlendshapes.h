@@ -0,0 +1,81 @@
+//
+//  QuantizedBlendshapes.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef QuantizedBlendshapes_hpp
+#define QuantizedBlendshapes_hpp
+
+#include "../shared/Matrix.h"
+
+#include "Rig.h"
+
+#include <vector>
+#include <cstdint>
+
+// Compact blendshape storage for playback.
+// Deltas are stored per blendshape as int16 or float16 values q, with
+// a per-blendshape scale and offset: delta = q * scale + offset.
+// Evaluation accumulates in float32.
+class QuantizedBlendshapes {
+public:
+    enum Format {
+        Int16,
+        Float16,
+    };
+
+    struct Error {
+        double max;
+        double rms;
+    };
+
+    QuantizedBlendshapes(Format format = Int16);
+
+    void build(const Rig &rig);
+
+    void evaluate(const Weights &weights, Eigen::VectorXf &points) const;
+
+    // Quantization error of the stored deltas
+    Error error(const Rig &rig) const;
+
+    // Evaluation error against the double-precision rig evaluation
+    Error error(const Rig &rig, const std::vector<Weights> &weights) const;
+
+    Format format() const { return _format; }
+
+    size_t numBlendshapes() const { return _scale.size() + 1; }
+
+    size_t sizeInBytes() const;
+
+private:
+    Format _format;
+
+    Eigen::Index _numValues;
+
+    Eigen::VectorXf _neutral;
+
+    // Indexed by blendshape - 1
+    std::vector<float> _scale;
+    std::vector<float> _offset;
+
+    std::vector<int16_t> _int16;
+    std::vector<Eigen::half> _float16;
+
+    void dequantize(int bs, Eigen::VectorXf &deltas) const;
+};
+
+inline std::string FormatName(QuantizedBlendshapes::Format format) {
+    switch (format) {
+        case QuantizedBlendshapes::Int16:
+            return "int16";
+        case QuantizedBlendshapes::Float16:
+            return "float16";
+    }
+
+    return "Unknown";
+}
+
+#endif /* QuantizedBlendshapes_hpp */
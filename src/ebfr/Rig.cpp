@@ -12,89 +12,167 @@
 #include "../shared/CSV.h"
 #include "../shared/Mesh.h"
 
+#include "../shared/Parallel.h"
+
 #include <fstream>
+#include <sstream>
 #include <random>
 
-void Rig::load(const std::string& dirPath, const std::string& posePath, const std::string& weightsPath, const std::string& vertexMaskPath, bool isTarget)
+Rig::Rig()
+: _ioThreads(8)
+, _meshProfile(MeshProfile::Light)
+, _precision(Precision::Double)
+{
+}
+
+bool Rig::load(const std::string& dirPath, const std::string& posePath, const std::string& weightsPath, const std::string& vertexMaskPath, bool isTarget)
 {
-    std::cout
+    // Rigs may be loaded concurrently, so the log is printed in one piece
+    std::ostringstream log;
+
+    log
             << "Reading " << (isTarget ? "Target" : "Source") << " Rig" << std::endl
             << "\t" << dirPath << std::endl;
 
     if (isTarget) {
-        loadNeutral(dirPath);
+        if (!loadNeutral(dirPath))
+            return false;
     } else {
-        loadBlendshapes(dirPath);
+        if (!loadBlendshapes(dirPath))
+            return false;
     }
 
-    PoseCSV csv;
-    if (!csv.open(weightsPath)) {
+    PoseTable table;
+    if (!table.read(weightsPath)) {
         std::cerr << "Failed to open Pose CSV " << weightsPath << std::endl;
-        return;
+        return false;
     }
 
-    std::cout
+    log
             << "\tPoses" << std::endl
             << "\t\t" << posePath << std::endl;
 
     std::vector<std::string> posePaths;
     std::vector<std::vector<double>> poseWeights;
 
-    std::string poseName;
-    std::vector<double> poseWeight;
-
-    while (csv.next()) {
-        csv.values(poseName, poseWeight);
+    for (auto row = 0; row < table.numRows(); row++) {
+        const auto &poseName = table.name(row);
+        const auto weights = table.weights(row);
 
-        if (!std::any_of(poseWeight.begin(), poseWeight.end(), [](double w) { return w > 0.0; }))
+        if (!std::any_of(weights, weights + table.numWeights(), [](double w) { return w > 0.0; }))
             continue;
 
         // Neutral/BS0
-        poseWeight.insert(poseWeight.begin(), 1);
+        std::vector<double> poseWeight(1, 1.0);
+        poseWeight.insert(poseWeight.end(), weights, weights + table.numWeights());
 
         posePaths.push_back(JoinPath(posePath, poseName + ".obj"));
         poseWeights.push_back(poseWeight);
 
-        std::cout << "\t\t" << poseName << " - ";
+        log << "\t\t" << poseName << " - ";
         for (auto w : poseWeight)
-            std::cout << w << " ";
-        std::cout << std::endl;
+            log << w << " ";
+        log << std::endl;
     }
 
-    loadPoses(posePaths, poseWeights);
+    if (!loadPoses(posePaths, poseWeights))
+        return false;
 
     if (!vertexMaskPath.empty()) {
         loadVertexMask(vertexMaskPath);
 
-        std::cout << "Modified Verticies: " << vertices().size() << " / " << numVertices(true) << std::endl;
-        std::cout << "Modified Faces: " << faces().size() << " / " << numFaces(true) << std::endl;
+        log << "Modified Verticies: " << vertices().size() << " / " << numVertices(true) << std::endl;
+        log << "Modified Faces: " << faces().size() << " / " << numFaces(true) << std::endl;
     }
 
-    return;
+    std::cout << log.str();
+
+    return true;
+}
+
+bool Rig::loadBlendshapes(const std::string &dirPath) {
+    return loadBlendshapes(dirPath, JoinPath(dirPath, "neutral.obj"));
 }
 
-void Rig::loadBlendshapes(const std::string &dirPath) {
+bool Rig::loadBlendshapes(const std::string &dirPath, const std::string &neutralPath) {
     std::vector<std::string> blendshapePaths;
     ListFiles(JoinPath(dirPath, "(\\d*).obj"), blendshapePaths);
-    blendshapePaths.insert(blendshapePaths.begin(), JoinPath(dirPath, "neutral.obj"));
+    blendshapePaths.insert(blendshapePaths.begin(), neutralPath);
 
-    loadBlendshapes(blendshapePaths);
+    return loadBlendshapes(blendshapePaths);
 }
 
-void Rig::loadBlendshapes(const std::vector<std::string> &paths) {
+bool Rig::loadBlendshapes(const std::vector<std::string> &paths) {
+    _blendshapes.clear();
+
+    // Connectivity is only built for the neutral
+    if (!loadNeutral(paths[0]))
+        return false;
+
+    std::vector<MeshPtr> meshes;
+    if (!loadMeshes(std::vector<std::string>(paths.begin() + 1, paths.end()), meshes))
+        return false;
+
     _blendshapes.resize(paths.size());
 
-    for (auto i = 0; i < paths.size(); i++) {
-        _blendshapes[i].setMesh(ReadMesh(paths[i]), i > 0);
+    for (auto i = 1; i < paths.size(); i++) {
+        _blendshapes[i].setMesh(meshes[i - 1], true);
     }
+
+    buildDeltas();
+
+    return true;
 }
 
-void Rig::loadNeutral(const std::string &path) {
+bool Rig::loadNeutral(const std::string &path) {
+    auto mesh = ReadMesh(path, false, _meshProfile);
+    if (mesh == nullptr)
+        return false;
+
+    setNeutral(mesh);
+
+    buildDeltas();
+
+    return true;
+}
+
+void Rig::setNeutral(MeshPtr mesh) {
     if (_blendshapes.empty()) {
         _blendshapes.resize(1);
     }
 
-    _blendshapes[0].setMesh(ReadMesh(path), false);
+    _blendshapes[0].setMesh(mesh, false);
+    _topology = MakeTopology(mesh);
+}
+
+bool Rig::loadMeshes(const std::vector<std::string> &paths, std::vector<MeshPtr> &meshes,
+                     const PoseLoadedCallback &loaded) const {
+    meshes.assign(paths.size(), nullptr);
+
+    ParallelForEach(paths.size(), [&](size_t i) {
+        meshes[i] = _topology != nullptr ? ReadMesh(paths[i], _topology, false) : ReadMesh(paths[i], false, _meshProfile);
+
+        if (loaded != nullptr && meshes[i] != nullptr)
+            loaded(i, paths.size(), meshes[i]);
+    }, _ioThreads);
+
+    std::vector<std::string> failed;
+
+    for (auto i = 0; i < paths.size(); i++) {
+        if (meshes[i] == nullptr)
+            failed.push_back(paths[i]);
+    }
+
+    if (!failed.empty()) {
+        std::cerr << "Failed to read " << failed.size() << " / " << paths.size() << " meshes:" << std::endl;
+
+        for (const auto &path : failed)
+            std::cerr << "\t" << path << std::endl;
+
+        return false;
+    }
+
+    return true;
 }
 
 void Rig::generateEmptyBlendshapes(size_t num) {
@@ -111,6 +189,165 @@ void Rig::generateEmptyBlendshapes(size_t num) {
 
         _blendshapes[i].setMesh(mesh, false);
     }
+
+    buildDeltas();
+}
+
+void Rig::reorder(const Reordering &reordering) {
+    const auto numV = numVertices(true);
+    const auto faces = reordering.permuteFaces(_topology->faces());
+
+    std::vector<double> positions(numV * 3);
+
+    reordering.permutePoints(neutral()->points(), positions.data());
+
+    auto neutralMesh = BuildMesh(positions.data(), numV, faces.data(), faces.size() / 3, _meshProfile);
+
+    auto permute = [&](MeshPtr mesh) {
+        auto permuted = MakeMesh(neutralMesh);
+
+        reordering.permutePoints(mesh->points(), positions.data());
+        CopyVertices(permuted, positions.data());
+
+        return permuted;
+    };
+
+    for (auto bs = 1; bs < numBlendshapes(); bs++) {
+        auto &blendshape = _blendshapes[bs];
+
+        // Fixed vertices stay in their original order, so the vertex solver's
+        // (seeded) selection of them doesn't depend on the vertex order
+        blendshape.setMesh(permute(blendshape.mesh()), false);
+        blendshape.setFixed(reordering.permuteVertexList(blendshape.fixed(), false));
+    }
+
+    for (auto &pose : _poses) {
+        pose.setMesh(permute(pose.mesh()));
+    }
+
+    setNeutral(neutralMesh);
+
+    _vertices = reordering.permuteVertexList(_vertices);
+    _faces = reordering.permuteFaceList(_faces);
+
+    buildDeltas();
+}
+
+std::shared_ptr<Rig> Rig::extractMasked(std::vector<int> &boundary) const {
+    const auto numV = numVertices();
+
+    // New index of each (old) masked vertex, -1 for the others
+    std::vector<int> vertexIndex(numVertices(true), -1);
+
+    for (auto i = 0; i < numV; i++) {
+        vertexIndex[vertex(i)] = i;
+    }
+
+    std::vector<int> faces;
+    faces.reserve(numFaces() * 3);
+
+    for (auto i = 0; i < numFaces(); i++) {
+        const auto f = _topology->face(face(i));
+
+        for (auto j = 0; j < 3; j++) {
+            faces.push_back(vertexIndex[f[j]]);
+        }
+    }
+
+    boundary.clear();
+
+    for (auto i = 0; i < numV; i++) {
+        const auto v = vertex(i);
+        const auto vertexFaces = _topology->vertexFaces(v);
+
+        for (auto j = 0; j < _topology->numVertexFaces(v); j++) {
+            if (!_faces.empty() && !std::binary_search(_faces.begin(), _faces.end(), vertexFaces[j])) {
+                boundary.push_back(i);
+                break;
+            }
+        }
+    }
+
+    std::vector<double> positions(numV * 3);
+
+    auto extract = [&](MeshPtr mesh) {
+        const auto points = mesh->points();
+
+        for (auto i = 0; i < numV; i++) {
+            const auto &p = points[vertex(i)];
+
+            positions[i * 3] = p[0];
+            positions[i * 3 + 1] = p[1];
+            positions[i * 3 + 2] = p[2];
+        }
+    };
+
+    extract(neutral());
+
+    auto neutralMesh = BuildMesh(positions.data(), numV, faces.data(), faces.size() / 3, _meshProfile);
+
+    auto extractMesh = [&](MeshPtr mesh) {
+        auto extracted = MakeMesh(neutralMesh);
+
+        extract(mesh);
+        CopyVertices(extracted, positions.data());
+
+        return extracted;
+    };
+
+    auto rig = MakeRig();
+
+    rig->_ioThreads = _ioThreads;
+    rig->_meshProfile = _meshProfile;
+    rig->_precision = _precision;
+
+    rig->setNeutral(neutralMesh);
+    rig->_blendshapes.resize(numBlendshapes());
+
+    for (auto bs = 1; bs < numBlendshapes(); bs++) {
+        const auto &blendshape = _blendshapes[bs];
+
+        // In their original order, as in reorder()
+        std::vector<int> fixed;
+
+        for (auto v : blendshape.fixed()) {
+            if (vertexIndex[v] >= 0) {
+                fixed.push_back(vertexIndex[v]);
+            }
+        }
+
+        rig->_blendshapes[bs].setMesh(extractMesh(blendshape.mesh()), false);
+        rig->_blendshapes[bs].setFixed(fixed);
+    }
+
+    for (const auto &pose : _poses) {
+        rig->_poses.emplace_back(extractMesh(pose.mesh()), pose.weights());
+    }
+
+    rig->buildDeltas();
+
+    return rig;
+}
+
+void Rig::insertMasked(const Rig &masked) {
+    const auto neutralPoints = neutral()->points();
+
+    for (auto bs = 1; bs < numBlendshapes(); bs++) {
+        auto points = blendshape(bs).mesh()->points();
+        const auto maskedPoints = masked.blendshape(bs).mesh()->points();
+
+        std::copy(neutralPoints, neutralPoints + numVertices(true), points);
+
+        for (auto i = 0; i < numVertices(); i++) {
+            points[vertex(i)] = maskedPoints[i];
+        }
+    }
+
+    for (auto pose = 0; pose < numPoses(); pose++) {
+        weights(pose) = masked.weights(pose);
+    }
+
+    buildDeltas();
 }
 
 void Rig::randomizeWeights() {
@@ -128,29 +365,166 @@ void Rig::randomizeWeights() {
     }
 }
 
+void Rig::buildDeltas() {
+    const auto numV = neutral()->n_vertices();
+
+    _neutralPoints.resize(numV * 3);
+    _deltas.resize(numV * 3, numBlendshapes() - 1);
+
+    for (auto bs = 0; bs < numBlendshapes(); bs++) {
+        updateDelta(bs);
+    }
+}
+
+void Rig::updateDelta(int bs) {
+    const auto mesh = blendshape(bs).mesh();
+
+    if (bs == 0) {
+        CopyVertices(_neutralPoints.data(), mesh);
+    } else {
+        CopyVertices(_deltas.col(bs - 1).data(), mesh);
+    }
+
+    if (_precision == Precision::Single) {
+        if (bs == 0) {
+            _neutralPointsSingle = _neutralPoints.cast<float>();
+        } else {
+            _deltasSingle.resize(_deltas.rows(), _deltas.cols());
+            _deltasSingle.col(bs - 1) = _deltas.col(bs - 1).cast<float>();
+        }
+    }
+}
+
+void Rig::setPrecision(Precision precision) {
+    _precision = precision;
+
+    if (_precision == Precision::Single) {
+        _neutralPointsSingle = _neutralPoints.cast<float>();
+        _deltasSingle = _deltas.cast<float>();
+    } else {
+        _neutralPointsSingle.resize(0);
+        _deltasSingle.resize(0, 0);
+    }
+}
+
+template<>
+const VectorXT<double> &Rig::neutralPointsAs<double>() const { return _neutralPoints; }
+
+template<>
+const VectorXT<float> &Rig::neutralPointsAs<float>() const { return _neutralPointsSingle; }
+
+template<>
+const MatrixXT<double> &Rig::deltasAs<double>() const { return _deltas; }
+
+template<>
+const MatrixXT<float> &Rig::deltasAs<float>() const { return _deltasSingle; }
+
+template<typename Scalar>
+void Rig::evaluate(const Weights &weights, VectorXT<Scalar> &points) const {
+    const auto &deltas = deltasAs<Scalar>();
+    const Eigen::Map<const VectorX> w(weights.data() + 1, deltas.cols());
+
+    points = neutralPointsAs<Scalar>();
+    points.noalias() += deltas * w.template cast<Scalar>();
+}
+
+template<typename Scalar>
+void Rig::evaluate(const std::vector<Weights> &weights, MatrixXT<Scalar> &points) const {
+    const auto &deltas = deltasAs<Scalar>();
+    MatrixXT<Scalar> w(deltas.cols(), weights.size());
+
+    for (auto i = 0; i < weights.size(); i++) {
+        w.col(i) = Eigen::Map<const VectorX>(weights[i].data() + 1, deltas.cols()).template cast<Scalar>();
+    }
+
+    points = neutralPointsAs<Scalar>().replicate(1, weights.size());
+    points.noalias() += deltas * w;
+}
+
+template<typename Scalar>
+void Rig::evaluate(const double *weights, size_t numPoses, MatrixXT<Scalar> &points) const {
+    const auto &deltas = deltasAs<Scalar>();
+    const Eigen::Map<const MatrixX> w(weights, deltas.cols(), numPoses);
+
+    points = neutralPointsAs<Scalar>().replicate(1, numPoses);
+    points.noalias() += deltas * w.template cast<Scalar>();
+}
+
+template void Rig::evaluate<float>(const Weights &, VectorXT<float> &) const;
+
+template void Rig::evaluate<double>(const Weights &, VectorXT<double> &) const;
+
+template void Rig::evaluate<float>(const std::vector<Weights> &, MatrixXT<float> &) const;
+
+template void Rig::evaluate<double>(const std::vector<Weights> &, MatrixXT<double> &) const;
+
+template void Rig::evaluate<float>(const double *, size_t, MatrixXT<float> &) const;
+
+template void Rig::evaluate<double>(const double *, size_t, MatrixXT<double> &) const;
+
 MeshPtr Rig::generatePose(int pose) const {
     return generatePose(weights(pose));
 }
 
-MeshPtr Rig::generatePose(const std::vector<double> &weights) const {
+MeshPtr Rig::generatePose(const Weights &weights) const {
     auto target = MakeMesh(neutral());
 
-    for (auto bs = 1; bs < numBlendshapes(); bs++) {
-        AddVertices(target, blendshape(bs).mesh(), weights[bs], target);
-    }
+    generatePose(weights, target);
 
     return target;
 }
 
-void Rig::loadPoses(const std::vector<std::string> &paths, const std::vector<Weights> &weights) {
+void Rig::generatePose(const Weights &weights, MeshPtr dest) const {
+    VectorX points;
+
+    if (_precision == Precision::Single) {
+        Eigen::VectorXf pointsSingle;
+        evaluate(weights, pointsSingle);
+
+        points = pointsSingle.cast<double>();
+    } else {
+        evaluate(weights, points);
+    }
+
+    CopyVertices(dest, points.data());
+}
+
+std::vector<MeshPtr> Rig::generatePoses(const std::vector<Weights> &weights) const {
+    MatrixX points;
+
+    if (_precision == Precision::Single) {
+        Eigen::MatrixXf pointsSingle;
+        evaluate(weights, pointsSingle);
+
+        points = pointsSingle.cast<double>();
+    } else {
+        evaluate(weights, points);
+    }
+
+    std::vector<MeshPtr> poses(weights.size());
+
+    for (auto i = 0; i < weights.size(); i++) {
+        poses[i] = MakeMesh(neutral());
+
+        CopyVertices(poses[i], points.col(i).data());
+    }
+
+    return poses;
+}
+
+bool Rig::loadPoses(const std::vector<std::string> &paths, const std::vector<Weights> &weights) {
+    std::vector<MeshPtr> meshes;
+    if (!loadMeshes(paths, meshes, _poseLoaded))
+        return false;
+
     _poses.resize(paths.size());
 
     for (auto i = 0; i < paths.size(); i++) {
-        auto mesh = ReadMesh(paths[i]);
-
-        _poses[i].setMesh(mesh);
+        _poses[i].setMesh(meshes[i]);
         _poses[i].setWeights(weights[i]);
     }
+
+    return true;
 }
 
 void Rig::loadVertexMask(const std::string &path) {
@@ -165,15 +539,7 @@ void Rig::loadVertexMask(const std::string &path) {
 
     file.close();
 
-    auto mesh = _poses[0].mesh();
-
-    for (auto v : _vertices) {
-        const auto vh = mesh->vertex_handle(v);
-
-        for (auto iter = mesh->cvf_begin(vh), end = mesh->cvf_end(vh); iter != end; iter++) {
-            _faces.emplace_back(iter->idx());
-        }
-    }
+    addVertexFaces();
 
     std::sort(_faces.begin(), _faces.end());
     auto lastF = std::unique(_faces.begin(), _faces.end());
@@ -185,11 +551,9 @@ void Rig::loadVertexMask(const std::string &path) {
     _vertices.reserve(_faces.size() * 3);
 
     for (auto f : _faces) {
-        const auto fh = mesh->face_handle(f);
+        const auto face = _topology->face(f);
 
-        for (auto iter = mesh->cfv_begin(fh), end = mesh->cfv_end(fh); iter != end; iter++) {
-            _vertices.emplace_back(iter->idx());
-        }
+        _vertices.insert(_vertices.end(), face, face + 3);
     }
 
     std::sort(_vertices.begin(), _vertices.end());
@@ -238,15 +602,7 @@ void Rig::findModified() {
     }
 
 
-    auto mesh = _poses[0].mesh();
-
-    for (auto v : _vertices) {
-        const auto vh = mesh->vertex_handle(v);
-
-        for (auto iter = mesh->cvf_begin(vh), end = mesh->cvf_end(vh); iter != end; iter++) {
-            _faces.emplace_back(iter->idx());
-        }
-    }
+    addVertexFaces();
 
     std::sort(_faces.begin(), _faces.end());
     auto lastF = std::unique(_faces.begin(), _faces.end());
@@ -255,6 +611,14 @@ void Rig::findModified() {
     }
 }
 
+void Rig::addVertexFaces() {
+    for (auto v : _vertices) {
+        const auto faces = _topology->vertexFaces(v);
+
+        _faces.insert(_faces.end(), faces, faces + _topology->numVertexFaces(v));
+    }
+}
+
 size_t Rig::faceIndex(size_t index) const {
     if (_faces.empty()) {
         return index;
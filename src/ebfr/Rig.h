@@ -10,8 +10,11 @@
 #define Rig_hpp
 
 #include "../shared/Mesh.h"
+#include "../shared/Matrix.h"
+#include "../shared/Reorder.h"
 
 #include <stdio.h>
+#include <functional>
 #include <memory>
 
 //class Weights : public std::vector<double>
@@ -84,14 +87,19 @@ public:
         return _fixed.size();
     }
 
+    // Not necessarily sorted once the rig is reordered
     bool isFixed(int v) const {
-        return std::binary_search(_fixed.begin(), _fixed.end(), v);
+        return std::find(_fixed.begin(), _fixed.end(), v) != _fixed.end();
     }
 
     const std::vector<int> &fixed() const {
         return _fixed;
     }
 
+    void setFixed(const std::vector<int> &fixed) {
+        _fixed = fixed;
+    }
+
 private:
     MeshPtr _mesh;
 
@@ -100,16 +108,37 @@ private:
 
 class Rig {
 public:
-    void load(const std::string &dirPath, const std::string &posePath, const std::string &weightsPath,
+    // Called from the loading threads as each pose mesh is read, before the
+    // rig's poses are set; numPoses is the number of poses being loaded.
+    typedef std::function<void(size_t pose, size_t numPoses, MeshPtr mesh)> PoseLoadedCallback;
+
+    Rig();
+
+    // Maximum number of meshes read concurrently
+    void setIOThreads(size_t num) { _ioThreads = num; }
+
+    // Attributes built for the rig's meshes; Light (no normals) by default
+    void setMeshProfile(MeshProfile profile) { _meshProfile = profile; }
+
+    MeshProfile meshProfile() const { return _meshProfile; }
+
+    void setPoseLoadedCallback(PoseLoadedCallback callback) { _poseLoaded = callback; }
+
+    bool load(const std::string &dirPath, const std::string &posePath, const std::string &weightsPath,
               const std::string &vertexMaskPath, bool isTarget);
 
-    void loadBlendshapes(const std::string &dirPath);
+    bool loadBlendshapes(const std::string &dirPath);
+
+    bool loadBlendshapes(const std::string &dirPath, const std::string &neutralPath);
 
-    void loadBlendshapes(const std::vector<std::string> &paths);
+    bool loadBlendshapes(const std::vector<std::string> &paths);
 
-    void loadNeutral(const std::string &path);
+    bool loadNeutral(const std::string &path);
 
-    void loadPoses(const std::vector<std::string> &paths, const std::vector<Weights> &weights);
+    // Sets the neutral/BS0 mesh; the rig's topology is built from it
+    void setNeutral(MeshPtr mesh);
+
+    bool loadPoses(const std::vector<std::string> &paths, const std::vector<Weights> &weights);
 
     void loadVertexMask(const std::string &path);
 
@@ -117,14 +146,62 @@ public:
 
     void generateEmptyBlendshapes(size_t num);
 
+    // Permutes the vertices and faces of every mesh of the rig (and the vertex
+    // mask), rebuilding the topology. Apply the inverse to restore the order.
+    void reorder(const Reordering &reordering);
+
+    // Copy of the rig over its masked faces and vertices only, with the mask
+    // cleared, so every stage run on it scales with the mask. The vertices on
+    // the mask's border (shared with unmasked faces) are returned in boundary,
+    // as indices of the copy.
+    std::shared_ptr<Rig> extractMasked(std::vector<int> &boundary) const;
+
+    // Copies the blendshapes and weights of a rig from extractMasked back;
+    // vertices outside of the mask are set to the neutral.
+    void insertMasked(const Rig &masked);
+
     void randomizeWeights();
 
+    // Rebuilds the neutral position vector and the 3V x (B - 1) delta matrix
+    // from the blendshape meshes. Called after the blendshapes are loaded or
+    // generated; use updateDelta when a single blendshape mesh is modified.
+    void buildDeltas();
+
+    void updateDelta(int bs);
+
+    // Single keeps float copies of the neutral and deltas next to the double
+    // ones; generatePose() then evaluates in float, halving the bandwidth.
+    void setPrecision(Precision precision);
+
+    Precision precision() const { return _precision; }
+
+    // Evaluates neutral + D * w for a single set of weights (GEMV).
+    // Weights include the neutral/BS0 entry, which is ignored.
+    // float needs the Single precision copies, see setPrecision().
+    template<typename Scalar>
+    void evaluate(const Weights &weights, VectorXT<Scalar> &points) const;
+
+    // Evaluates a batch of weights (GEMM), one pose per column.
+    template<typename Scalar>
+    void evaluate(const std::vector<Weights> &weights, MatrixXT<Scalar> &points) const;
+
+    // Evaluates numPoses sets of weights stored contiguously, numBlendshapes() - 1
+    // per pose and without the neutral/BS0 entry (e.g. rows of a PoseTable).
+    template<typename Scalar>
+    void evaluate(const double *weights, size_t numPoses, MatrixXT<Scalar> &points) const;
+
     MeshPtr generatePose(int pose) const;
 
-    MeshPtr generatePose(const std::vector<double> &weights) const;
+    MeshPtr generatePose(const Weights &weights) const;
+
+    void generatePose(const Weights &weights, MeshPtr dest) const;
+
+    std::vector<MeshPtr> generatePoses(const std::vector<Weights> &weights) const;
 
     MeshPtr neutral() const { return _blendshapes[0].mesh(); }
 
+    TopologyPtr topology() const { return _topology; }
+
     size_t numVertices(bool all = false) const {
         return _vertices.empty() || all ? neutral()->n_vertices() : _vertices.size();
     }
@@ -153,6 +230,10 @@ public:
 
     size_t numBlendshapes() const { return _blendshapes.size(); }
 
+    const VectorX &neutralPoints() const { return _neutralPoints; }
+
+    const MatrixX &deltas() const { return _deltas; }
+
     std::vector<Pose> &poses() { return _poses; }
 
     const std::vector<Pose> &poses() const { return _poses; }
@@ -180,12 +261,41 @@ public:
     }
 
 private:
+    size_t _ioThreads;
+
+    MeshProfile _meshProfile;
+
+    PoseLoadedCallback _poseLoaded;
+
+    TopologyPtr _topology;
+
     std::vector<Blendshape> _blendshapes;
 
     std::vector<Pose> _poses;
 
+    Precision _precision;
+
+    VectorX _neutralPoints;
+    MatrixX _deltas;
+
+    Eigen::VectorXf _neutralPointsSingle;
+    Eigen::MatrixXf _deltasSingle;
+
+    template<typename Scalar>
+    const VectorXT<Scalar> &neutralPointsAs() const;
+
+    template<typename Scalar>
+    const MatrixXT<Scalar> &deltasAs() const;
+
     std::vector<int> _vertices;
     std::vector<int> _faces;
+
+    // Reads the meshes concurrently; reports every failure rather than stopping at the first
+    bool loadMeshes(const std::vector<std::string> &paths, std::vector<MeshPtr> &meshes,
+                    const PoseLoadedCallback &loaded = nullptr) const;
+
+    // Appends the faces around each of _vertices to _faces (unsorted)
+    void addVertexFaces();
 };
 
 typedef std::shared_ptr<Rig> RigPtr;
@@ -0,0 +1,217 @@
+//
+//  RigCache.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "RigCache.h"
+
+#include "../shared/FS.h"
+#include "../shared/Hash.h"
+#include "../shared/MappedFile.h"
+#include "../shared/Parallel.h"
+
+#include <fstream>
+#include <iostream>
+
+static uint64_t AlignOffset(uint64_t offset) {
+    return (offset + RigCacheAlignment - 1) / RigCacheAlignment * RigCacheAlignment;
+}
+
+static uint64_t HashFileInfo(const std::string &path, uint64_t hash) {
+    uint64_t size = 0;
+    int64_t modified = 0;
+
+    FileInfo(path, size, modified);
+
+    hash = Hash(path, hash);
+    hash = HashValue(size, hash);
+    hash = HashValue(modified, hash);
+
+    return hash;
+}
+
+uint64_t RigCacheKey(const std::string &dirPath, const std::string &posePath, const std::string &weightsPath) {
+    auto hash = HashValue(RigCacheVersion);
+
+    // Same files as Rig::loadBlendshapes
+    std::vector<std::string> blendshapePaths;
+    ListFiles(JoinPath(dirPath, "(\\d*).obj"), blendshapePaths);
+    blendshapePaths.insert(blendshapePaths.begin(), JoinPath(dirPath, "neutral.obj"));
+
+    for (const auto &path : blendshapePaths) {
+        hash = HashFileInfo(path, hash);
+    }
+
+    std::vector<std::string> posePaths;
+    ListFiles(JoinPath(posePath, ".*\\.obj"), posePaths);
+
+    for (const auto &path : posePaths) {
+        hash = HashFileInfo(path, hash);
+    }
+
+    return HashFileInfo(weightsPath, hash);
+}
+
+bool WriteRigCache(const std::string &path, const Rig &rig, uint64_t key) {
+    const auto numV = rig.numVertices(true);
+    const auto numBS = rig.numBlendshapes();
+    const auto numPoses = rig.numPoses();
+    const auto &faces = rig.topology()->faces();
+
+    RigCacheHeader header = {};
+    header.magic = RigCacheMagic;
+    header.version = RigCacheVersion;
+    header.key = key;
+    header.numVertices = numV;
+    header.numFaces = faces.size() / 3;
+    header.numBlendshapes = numBS;
+    header.numPoses = numPoses;
+
+    header.facesOffset = AlignOffset(sizeof(RigCacheHeader));
+    header.blendshapesOffset = AlignOffset(header.facesOffset + faces.size() * sizeof(int32_t));
+    header.posesOffset = AlignOffset(header.blendshapesOffset + numBS * numV * 3 * sizeof(double));
+    header.weightsOffset = AlignOffset(header.posesOffset + numPoses * numV * 3 * sizeof(double));
+    header.size = header.weightsOffset + numPoses * numBS * sizeof(double);
+
+    std::vector<char> buffer(header.size, 0);
+
+    std::copy(faces.begin(), faces.end(), (int32_t *) (buffer.data() + header.facesOffset));
+
+    auto blendshapes = (double *) (buffer.data() + header.blendshapesOffset);
+    for (auto bs = 0; bs < numBS; bs++, blendshapes += numV * 3) {
+        CopyVertices(blendshapes, rig.blendshape(bs).mesh());
+    }
+
+    auto poses = (double *) (buffer.data() + header.posesOffset);
+    auto weights = (double *) (buffer.data() + header.weightsOffset);
+    for (auto pose = 0; pose < numPoses; pose++, poses += numV * 3, weights += numBS) {
+        CopyVertices(poses, rig.pose(pose).mesh());
+
+        const auto &w = rig.weights(pose);
+        std::copy(w.begin(), w.end(), weights);
+    }
+
+    header.contentHash = Hash(buffer.data() + sizeof(RigCacheHeader), buffer.size() - sizeof(RigCacheHeader));
+
+    std::copy((const char *) &header, (const char *) &header + sizeof(RigCacheHeader), buffer.begin());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open rig cache " << path << std::endl;
+        return false;
+    }
+
+    file.write(buffer.data(), buffer.size());
+
+    if (!file.good()) {
+        std::cerr << "Failed to write rig cache " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool ReadRigCache(const std::string &path, Rig &rig, uint64_t key, bool verify) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open rig cache " << path << std::endl;
+        return false;
+    }
+
+    if (file.size() < sizeof(RigCacheHeader)) {
+        std::cerr << "Invalid rig cache " << path << std::endl;
+        return false;
+    }
+
+    const auto &header = *(const RigCacheHeader *) file.data();
+
+    if (header.magic != RigCacheMagic || header.version != RigCacheVersion || header.size != file.size()) {
+        std::cerr << "Invalid rig cache " << path << std::endl;
+        return false;
+    }
+
+    if (key != 0 && header.key != key) {
+        std::cerr << "Rig cache " << path << " is out of date" << std::endl;
+        return false;
+    }
+
+    if (verify && header.contentHash != Hash(file.data() + sizeof(RigCacheHeader), file.size() - sizeof(RigCacheHeader))) {
+        std::cerr << "Rig cache " << path << " is corrupt" << std::endl;
+        return false;
+    }
+
+    const auto numV = header.numVertices;
+    const auto faces = (const int32_t *) (file.data() + header.facesOffset);
+    const auto blendshapes = (const double *) (file.data() + header.blendshapesOffset);
+    const auto poses = (const double *) (file.data() + header.posesOffset);
+    const auto weights = (const double *) (file.data() + header.weightsOffset);
+
+    // Connectivity is only built for the neutral, the other meshes share it
+    auto neutral = BuildMesh(blendshapes, numV, faces, header.numFaces, rig.meshProfile());
+
+    rig.blendshapes().clear();
+    rig.setNeutral(neutral);
+
+    rig.blendshapes().resize(header.numBlendshapes);
+    rig.poses().resize(header.numPoses);
+
+    ParallelForEach(header.numBlendshapes - 1 + header.numPoses, [&](size_t i) {
+        const auto bs = i + 1;
+        const auto pose = bs - header.numBlendshapes;
+
+        auto mesh = MakeMesh(neutral);
+
+        if (bs < header.numBlendshapes) {
+            CopyVertices(mesh, blendshapes + bs * numV * 3);
+        } else {
+            CopyVertices(mesh, poses + pose * numV * 3);
+        }
+
+        if (mesh->has_vertex_normals()) {
+            mesh->update_face_normals();
+            mesh->update_vertex_normals();
+        }
+
+        if (bs < header.numBlendshapes) {
+            rig.blendshape(bs).setMesh(mesh, true);
+        } else {
+            rig.pose(pose).setMesh(mesh);
+            rig.pose(pose).setWeights(Weights(weights + pose * header.numBlendshapes, weights + (pose + 1) * header.numBlendshapes));
+        }
+    });
+
+    rig.buildDeltas();
+
+    return true;
+}
+
+bool LoadCachedRig(Rig &rig, const std::string &cachePath,
+                   const std::string &dirPath, const std::string &posePath, const std::string &weightsPath,
+                   const std::string &vertexMaskPath) {
+    const auto key = RigCacheKey(dirPath, posePath, weightsPath);
+
+    if (Exists(cachePath) && ReadRigCache(cachePath, rig, key)) {
+        std::cout
+                << "Reading Source Rig" << std::endl
+                << "\t" << cachePath << std::endl;
+
+        if (!vertexMaskPath.empty()) {
+            rig.loadVertexMask(vertexMaskPath);
+        }
+
+        return true;
+    }
+
+    if (!rig.load(dirPath, posePath, weightsPath, vertexMaskPath, false))
+        return false;
+
+    // The rig is still usable if the cache can't be written
+    if (WriteRigCache(cachePath, rig, key)) {
+        std::cout << "Wrote rig cache " << cachePath << std::endl;
+    }
+
+    return true;
+}
@@ -0,0 +1,72 @@
+//
+//  RigCache.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef RigCache_hpp
+#define RigCache_hpp
+
+#include "Rig.h"
+
+#include <cstdint>
+#include <string>
+
+// Binary rig cache (.ebfrc)
+//
+// Holds everything Rig::load reads from the blendshape directory, pose directory
+// and weights CSV so the rig can be restored without parsing any OBJ text.
+// The file is memory mapped on load; every block is aligned to RigCacheAlignment.
+//
+// Layout (native byte order):
+//   RigCacheHeader
+//   Faces:       # of faces x 3 int32 vertex indices
+//   Blendshapes: # of blendshapes x # of vertices x 3 float64 (BS0 is the neutral)
+//   Poses:       # of poses x # of vertices x 3 float64
+//   Weights:     # of poses x # of blendshapes float64 (including the neutral/BS0 entry)
+
+const uint32_t RigCacheMagic = 0x43464245; // EBFC
+const uint32_t RigCacheVersion = 1;
+const uint64_t RigCacheAlignment = 64;
+
+struct RigCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+
+    // Identifies the files the cache was built from, see RigCacheKey
+    uint64_t key;
+
+    // Hash of everything following the header
+    uint64_t contentHash;
+
+    uint64_t numVertices;
+    uint64_t numFaces;
+    uint64_t numBlendshapes;
+    uint64_t numPoses;
+
+    uint64_t facesOffset;
+    uint64_t blendshapesOffset;
+    uint64_t posesOffset;
+    uint64_t weightsOffset;
+
+    uint64_t size;
+};
+
+// Hash of the paths, sizes and modification times of the files a rig is loaded from
+uint64_t RigCacheKey(const std::string &dirPath, const std::string &posePath, const std::string &weightsPath);
+
+bool WriteRigCache(const std::string &path, const Rig &rig, uint64_t key = 0);
+
+// Restores the rig from a cache file. A non-zero key must match the cache's key;
+// verify re-hashes the content to catch truncated or corrupt files.
+bool ReadRigCache(const std::string &path, Rig &rig, uint64_t key = 0, bool verify = true);
+
+// Reads the rig from the cache when it is up to date with the source files,
+// otherwise loads the rig with Rig::load and (re)writes the cache
+bool LoadCachedRig(Rig &rig, const std::string &cachePath,
+                   const std::string &dirPath, const std::string &posePath, const std::string &weightsPath,
+                   const std::string &vertexMaskPath);
+
+#endif /* RigCache_hpp */
@@ -15,6 +15,7 @@ SolverBase::SolverBase()
 , _target(nullptr)
 , _targetGradients(nullptr)
 , _useMultithreaded(false)
+, _precision(Precision::Double)
 , _debugPath()
 , _debug(false)
 {
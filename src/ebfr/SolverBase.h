@@ -33,6 +33,8 @@ public:
 
     void setMultithreaded(bool enable);
 
+    void setPrecision(Precision precision) { _precision = precision; }
+
     void setDebugPath(const std::string &path) { _debugPath = path; }
 
     void setStepCallback(StepCallback callback) { _callback = callback; }
@@ -51,6 +53,8 @@ protected:
 
     bool _useMultithreaded;
 
+    Precision _precision;
+
     RigPtr _source;
     GradientsPtr _sourceGradients;
 
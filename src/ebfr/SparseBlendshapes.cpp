@@ -0,0 +1,106 @@
+//
+//  SparseBlendshapes.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "SparseBlendshapes.h"
+
+SparseBlendshapes::SparseBlendshapes(double eps)
+: _eps(eps)
+, _frame(0)
+, _isIncremental(false)
+{
+}
+
+void SparseBlendshapes::build(const Rig &rig) {
+    const auto numV = rig.neutral()->n_vertices();
+
+    _neutral.resize(numV * 3);
+    CopyVertices(_neutral.data(), rig.neutral());
+
+    _shapes.clear();
+    _shapes.resize(rig.numBlendshapes());
+
+    for (auto bs = 1; bs < rig.numBlendshapes(); bs++) {
+        const auto *points = rig.blendshape(bs).mesh()->points();
+
+        auto &shape = _shapes[bs];
+
+        for (auto v = 0; v < numV; v++) {
+            const auto &d = points[v];
+
+            if (isNearZero(d, _eps))
+                continue;
+
+            shape.vertices.emplace_back(v);
+
+            shape.deltas.emplace_back(d[0]);
+            shape.deltas.emplace_back(d[1]);
+            shape.deltas.emplace_back(d[2]);
+        }
+    }
+
+    _stamp.assign(numV, 0);
+    _frame = 0;
+
+    reset();
+}
+
+void SparseBlendshapes::reset() {
+    _touched.clear();
+    _isIncremental = false;
+}
+
+void SparseBlendshapes::evaluate(const Weights &weights, VectorX &points) {
+    if (!_isIncremental || points.size() != _neutral.size()) {
+        points = _neutral;
+    } else {
+        for (auto v : _touched) {
+            points.segment<3>(v * 3) = _neutral.segment<3>(v * 3);
+        }
+    }
+
+    _touched.clear();
+    _isIncremental = true;
+
+    // Stamps are only compared for equality, so restart them on wrap-around
+    if (++_frame == 0) {
+        std::fill(_stamp.begin(), _stamp.end(), 0);
+        _frame = 1;
+    }
+
+    // Gather the active blendshapes
+    _active.clear();
+    for (auto bs = 1; bs < _shapes.size(); bs++) {
+        if (weights[bs] != 0.0 && !_shapes[bs].vertices.empty())
+            _active.emplace_back(bs);
+    }
+
+    auto *p = points.data();
+
+    for (auto bs : _active) {
+        const auto w = weights[bs];
+        const auto &shape = _shapes[bs];
+
+        const auto *vertices = shape.vertices.data();
+        const auto *d = shape.deltas.data();
+
+        for (auto i = 0; i < shape.vertices.size(); i++, d += 3) {
+            const auto v = vertices[i];
+
+            if (_stamp[v] != _frame) {
+                _stamp[v] = _frame;
+                _touched.emplace_back(v);
+            }
+
+            auto *pv = p + (v * 3);
+
+            pv[0] += w * d[0];
+            pv[1] += w * d[1];
+            pv[2] += w * d[2];
+        }
+    }
+}
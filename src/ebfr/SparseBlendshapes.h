@@ -0,0 +1,70 @@
+//
+//  SparseBlendshapes.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef SparseBlendshapes_hpp
+#define SparseBlendshapes_hpp
+
+#include "../shared/Matrix.h"
+
+#include "Rig.h"
+
+#include <vector>
+
+// Pose evaluation for sparse weight vectors.
+// Each blendshape is stored as the list of vertices it moves (its support)
+// and the packed deltas for those vertices. Evaluation only visits the
+// active (non-zero weight) blendshapes, and only the vertices they touch.
+class SparseBlendshapes {
+public:
+    SparseBlendshapes(double eps = 0.00001);
+
+    void build(const Rig &rig);
+
+    // Evaluates a pose into points (3V). Consecutive frames are incremental:
+    // points must still hold the previous frame's result, as only the vertices
+    // touched by that frame are restored to the neutral. Call reset() before
+    // evaluating into a different (or modified) buffer.
+    void evaluate(const Weights &weights, VectorX &points);
+
+    // Starts a new sequence; the next evaluate() writes every vertex
+    void reset();
+
+    size_t numBlendshapes() const { return _shapes.size(); }
+
+    size_t numVertices() const { return _neutral.size() / 3; }
+
+    const std::vector<int> &support(int bs) const { return _shapes[bs].vertices; }
+
+    size_t numActive() const { return _active.size(); }
+
+    size_t numTouched() const { return _touched.size(); }
+
+private:
+    struct Shape {
+        std::vector<int> vertices;
+        std::vector<double> deltas;
+    };
+
+    double _eps;
+
+    VectorX _neutral;
+
+    // Indexed by blendshape; [0] (neutral) is always empty
+    std::vector<Shape> _shapes;
+
+    std::vector<int> _active;
+
+    std::vector<int> _touched;
+    std::vector<unsigned int> _stamp;
+    unsigned int _frame;
+
+    // Whether the next evaluate() continues from the previous frame
+    bool _isIncremental;
+};
+
+#endif /* SparseBlendshapes_hpp */
@@ -8,6 +8,8 @@
 
 #include "VertexSolver.h"
 
+#include "../shared/FS.h"
+#include "../shared/Hash.h"
 #include "../shared/Timing.h"
 
 #include <random>
@@ -22,6 +24,9 @@ VertexSolver::VertexSolver()
 , _fixedWeight(0.5)
 , _maxFixed(100)
 , _randomFixed(true)
+, _refinementSteps(2)
+, _useRegions(false)
+, _regionRings(2)
 {
 
 }
@@ -91,20 +96,92 @@ bool VertexSolver::transfer(Index bs) {
 
     auto &solver = _solvers[bs];
 
+    if (!solver.initialized && (_useRegions || !_pinnedVertices.empty()) && !_usePhantom) {
+        findRegion(bs, solver);
+    }
+
+    // Nothing moves, the blendshape stays at the neutral
+    if (solver.hasRegion() && solver.regionVertices.empty()) {
+        solver.initialized = true;
+
+        copyTo(bs, solver.x, solver);
+        return true;
+    }
+
+    if (_precision == Precision::Single)
+        return transferSingle(bs);
+
     if (!solver.initialized) {
         SparseMatrix a;
 
-        constructA(bs, a);
+        constructA(bs, solver, a);
 
-        TIMER_START(Compute);
+        solver.at = a.transpose();
+
+        // A covers the topology, the neutral's geometry and the fixed vertices
+        const auto key = _cacheDir.empty() ? 0 : LDLTFactorsKey(a);
+        const auto cachePath = _cacheDir.empty() ? "" : JoinPath(_cacheDir, HashName(key) + ".ebfrv");
+
+        if (!cachePath.empty() && Exists(cachePath)) {
+            solver.factors.read(cachePath, key);
+        }
+
+        if (!solver.factors.isValid()) {
+            TIMER_START(Compute);
+
+            solver.solver.compute(solver.at * a);
+
+            TIMER_END(Compute);
+
+            if (!checkSolverError(solver.solver)) {
+                std::cerr << "Vertex Solver failed to init" << std::endl;
+                return false;
+            }
+
+            if (!cachePath.empty()) {
+                LDLTFactors factors;
+                factors.set(solver.solver);
+                factors.write(cachePath, key);
+            }
+        }
+
+        solver.initialized = true;
+    }
+
+    constructC(bs, solver);
+
+    if (solver.factors.isValid()) {
+        solver.factors.solve(solver.at * solver.c, solver.x);
+    } else {
+        solver.x = solver.solver.solve(solver.at * solver.c);
+
+        if (!checkSolverError(solver.solver))
+            return false;
+    }
+
+    copyTo(bs, solver.x, solver);
+
+    return true;
+}
+
+bool VertexSolver::transferSingle(Index bs) {
+    auto &solver = _solvers[bs];
+
+    if (!solver.initialized) {
+        SparseMatrix a;
+
+        constructA(bs, solver, a);
 
         solver.at = a.transpose();
+        solver.ata = solver.at * a;
+
+        TIMER_START(Compute);
 
-        solver.solver.compute(solver.at * a);
+        solver.solverSingle.compute(solver.ata.cast<float>());
 
         TIMER_END(Compute);
 
-        if (!checkSolverError(solver.solver)) {
+        if (!checkSolverError(solver.solverSingle)) {
             std::cerr << "Vertex Solver failed to init" << std::endl;
             return false;
         }
@@ -112,18 +189,154 @@ bool VertexSolver::transfer(Index bs) {
         solver.initialized = true;
     }
 
-    constructC(bs, solver.c);
+    constructC(bs, solver);
 
-    solver.x = solver.solver.solve(solver.at * solver.c);
+    const VectorX b = solver.at * solver.c;
 
-    if (!checkSolverError(solver.solver))
+    solver.x = solver.solverSingle.solve(b.cast<float>()).cast<double>();
+
+    if (!checkSolverError(solver.solverSingle))
         return false;
 
-    copyTo(bs, solver.x);
+    // x += (A^T A)^-1 (b - A^T A x), the residual in double and the correction in float
+    for (auto step = 0; step < _refinementSteps; step++) {
+        const VectorX r = b - solver.ata * solver.x;
+
+        solver.x += solver.solverSingle.solve(r.cast<float>()).cast<double>();
+    }
+
+    copyTo(bs, solver.x, solver);
 
     return true;
 }
 
+void VertexSolver::findRegion(Index bs, SolverData &solver) const {
+    const auto topology = _target->topology();
+    const auto numVertices = _target->numVertices(true);
+
+    std::vector<char> inRegion(numVertices, 1);
+
+    if (_useRegions) {
+        // The vertices that move in the source blendshape...
+        for (auto v : _source->blendshape(bs).fixed()) {
+            inRegion[v] = 0;
+        }
+
+        // ...grown by the rings, so the deformation can fall off before the pinned boundary
+        for (auto ring = 0; ring < _regionRings; ring++) {
+            auto grown = inRegion;
+
+            for (auto v = 0; v < numVertices; v++) {
+                if (!inRegion[v])
+                    continue;
+
+                const auto faces = topology->vertexFaces(v);
+
+                for (auto i = 0; i < topology->numVertexFaces(v); i++) {
+                    const auto face = topology->face(faces[i]);
+
+                    grown[face[0]] = grown[face[1]] = grown[face[2]] = 1;
+                }
+            }
+
+            inRegion.swap(grown);
+        }
+    }
+
+    for (auto v : _pinnedVertices) {
+        inRegion[v] = 0;
+    }
+
+    solver.regionVertices.clear();
+    solver.regionFaces.clear();
+    solver.regionColumns.assign(numVertices, -1);
+
+    for (auto v = 0; v < numVertices; v++) {
+        if (inRegion[v]) {
+            solver.regionColumns[v] = (int) solver.regionVertices.size();
+            solver.regionVertices.push_back(v);
+        }
+    }
+
+    // Everything moves, solve the whole mesh
+    if (solver.regionVertices.size() == numVertices) {
+        solver.regionVertices.clear();
+        solver.regionColumns.clear();
+        return;
+    }
+
+    for (auto face = 0; face < _target->numFaces(true); face++) {
+        const auto faceVertices = topology->face(face);
+
+        if (inRegion[faceVertices[0]] || inRegion[faceVertices[1]] || inRegion[faceVertices[2]]) {
+            solver.regionFaces.push_back(face);
+        }
+    }
+
+    if (_debug) {
+        std::cout
+                << "\tRegion: " << solver.regionVertices.size() << " / " << numVertices << " Vertices, "
+                << solver.regionFaces.size() << " / " << _target->numFaces(true) << " Faces" << std::endl;
+    }
+}
+
+void VertexSolver::constructA(Index bs, const SolverData &solver, SparseMatrix &a) {
+    if (solver.hasRegion()) {
+        constructRegionA(bs, solver, a);
+    } else {
+        constructA(bs, a);
+    }
+}
+
+void VertexSolver::constructRegionA(Index bs, const SolverData &solver, SparseMatrix &a) {
+    const auto topology = _target->topology();
+    const auto &columns = solver.regionColumns;
+
+    TripletList m;
+    m.reserve(solver.regionFaces.size() * _mSize * 3);
+
+    MatrixE e;
+
+    auto row = 0;
+
+    // As constructA, with the pinned vertices' terms moved to C
+    for (auto face : solver.regionFaces) {
+        constructE(face, e);
+
+        const auto faceVertices = topology->face(face);
+
+        for (int coord = 0; coord < 3; coord++) {
+            for (int eqn = 0; eqn < 3; eqn++, row++) {
+                for (int vert = 0; vert < 3; vert++) {
+                    const auto col = columns[faceVertices[vert]];
+
+                    if (col >= 0) {
+                        m.emplace_back(row, vertexIndex(col) + coord, e(eqn, vert));
+                    }
+                }
+            }
+        }
+    }
+
+    for (auto v : _fixedVertices[bs]) {
+        const auto col = columns[v];
+
+        if (col < 0)
+            continue;
+
+        for (auto j = 0; j < 3; j++, row++) {
+            m.emplace_back(row, vertexIndex(col) + j, _fixedWeight);
+        }
+    }
+
+    a.resize(row, solver.regionVertices.size() * _vSize);
+    a.setZero();
+
+    a.setFromTriplets(m.begin(), m.end());
+
+    a.makeCompressed();
+}
+
 void VertexSolver::constructA(int bs, SparseMatrix &a) {
     auto rows = _target->numFaces(true) * _mSize;
 
@@ -231,25 +444,81 @@ void VertexSolver::constructC(Index bs, MatrixX &c) {
     c.resize(rows, 1);
     c.setZero();
 
-    const auto &neutralM = _targetGradients->blendshapeM[0];
-    const auto &neutralMInv = _targetGradients->blendshapeMInv[0];
-    const auto &blendshapeM = _targetGradients->blendshapeM[bs];
-
-    const auto I = Matrix3x3::Identity();
+    Matrix3x3 q;
 
     for (auto face = 0; face < _target->numFaces(true); face++) {
-        const auto &m = blendshapeM[face];
+        constructQ(bs, face, q);
 
-        if (m.isZero()) {
-            constructC(face, I, c);
-        } else {
-            constructC(face, (neutralM[face] + m) * neutralMInv[face], c);
-        }
+        constructC(face, q, c);
     }
 
     constructFixedC(bs, c);
 }
 
+void VertexSolver::constructC(Index bs, SolverData &solver) {
+    if (solver.hasRegion()) {
+        constructRegionC(bs, solver, solver.c);
+    } else {
+        constructC(bs, solver.c);
+    }
+}
+
+void VertexSolver::constructRegionC(Index bs, const SolverData &solver, MatrixX &c) {
+    const auto topology = _target->topology();
+    const auto &columns = solver.regionColumns;
+
+    const auto &neutral = _target->neutralPoints();
+
+    c.resize(solver.at.cols(), 1);
+
+    MatrixE e;
+    Matrix3x3 q;
+
+    auto row = 0;
+
+    for (auto face : solver.regionFaces) {
+        constructQ(bs, face, q);
+        constructE(face, e);
+
+        const auto faceVertices = topology->face(face);
+
+        for (int coord = 0; coord < 3; coord++) {
+            for (int eqn = 0; eqn < 3; eqn++, row++) {
+                auto value = q(coord, eqn);
+
+                for (int vert = 0; vert < 3; vert++) {
+                    const auto v = faceVertices[vert];
+
+                    if (columns[v] < 0) {
+                        value -= e(eqn, vert) * neutral(vertexIndex(v) + coord);
+                    }
+                }
+
+                c(row, 0) = value;
+            }
+        }
+    }
+
+    for (auto v : _fixedVertices[bs]) {
+        if (columns[v] < 0)
+            continue;
+
+        for (auto j = 0; j < 3; j++, row++) {
+            c(row, 0) = _fixedWeight * neutral(vertexIndex(v) + j);
+        }
+    }
+}
+
+void VertexSolver::constructQ(Index bs, Index face, Matrix3x3 &q) const {
+    const auto &m = _targetGradients->blendshapeM(bs, face);
+
+    if (m.isZero()) {
+        q.setIdentity();
+    } else {
+        q = (_targetGradients->blendshapeM(0, face) + m) * _targetGradients->blendshapeMInv(0, face);
+    }
+}
+
 void VertexSolver::constructC(const Index face, const Matrix3x3 &q, MatrixX &c) {
     auto row = face * MatrixQ::RowsAtCompileTime;
 
@@ -280,16 +549,37 @@ void VertexSolver::constructFixedC(Index bs, MatrixX &c) {
     }
 }
 
-void VertexSolver::copyTo(Index bs, MatrixX &x) const {
+void VertexSolver::copyTo(Index bs, MatrixX &x, const SolverData &solver) const {
     auto target = _target->blendshape(bs).mesh();
 
-    for (auto v = 0; v < _target->numVertices(true); v++) {
-        const auto vh = target->vertex_handle(v);
-        const auto idx = vertexIndex(v);
+    if (solver.hasRegion()) {
+        const auto &neutral = _target->neutralPoints();
 
-        target->point(vh) = OpenMesh::Vec3d(x(idx, 0), x(idx + 1, 0), x(idx + 2, 0));;
+        for (auto v = 0; v < _target->numVertices(true); v++) {
+            const auto vh = target->vertex_handle(v);
+            const auto col = solver.regionColumns[v];
+
+            if (col < 0) {
+                const auto idx = vertexIndex(v);
+
+                target->point(vh) = OpenMesh::Vec3d(neutral(idx), neutral(idx + 1), neutral(idx + 2));
+            } else {
+                const auto idx = vertexIndex(col);
+
+                target->point(vh) = OpenMesh::Vec3d(x(idx, 0), x(idx + 1, 0), x(idx + 2, 0));
+            }
+        }
+    } else {
+        for (auto v = 0; v < _target->numVertices(true); v++) {
+            const auto vh = target->vertex_handle(v);
+            const auto idx = vertexIndex(v);
+
+            target->point(vh) = OpenMesh::Vec3d(x(idx, 0), x(idx + 1, 0), x(idx + 2, 0));;
+        }
     }
 
+    _target->updateDelta(bs);
+
     if (_debug) {
         auto neutral = _target->neutral();
         const auto &fixedVertices = _fixedVertices[bs];
@@ -320,18 +610,19 @@ Index VertexSolver::vertexIndex(Index idx) const {
 }
 
 void VertexSolver::vertexIndices(const Index face, Index vertices[]) const {
-    const auto mesh = _target->blendshape(0).mesh();
-    const auto fh = mesh->face_handle(face);
+    const auto faceVertices = _target->topology()->face(face);
 
-    size_t i = 0;
-    for (auto vertIter = mesh->cfv_begin(fh), vertEnd = mesh->cfv_end(fh);
-         i < 3 && vertIter != vertEnd; vertIter++, i++) {
-        vertices[i] = vertexIndex(vertIter->idx());
+    for (auto i = 0; i < 3; i++) {
+        vertices[i] = vertexIndex(faceVertices[i]);
     }
 
-    vertices[3] = (Index) ((_target->numVertices(true) + fh.idx()) * _vSize);
+    vertices[3] = (Index) ((_target->numVertices(true) + face) * _vSize);
 }
 
 bool VertexSolver::checkSolverError(const Solver &solver) const {
     return SolverBase::checkSolverError(solver.info());
 }
+
+bool VertexSolver::checkSolverError(const SolverSingle &solver) const {
+    return SolverBase::checkSolverError(solver.info());
+}
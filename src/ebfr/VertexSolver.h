@@ -10,11 +10,34 @@
 #define VertexSolver_hpp
 
 #include "SolverBase.h"
+#include "LDLTFactors.h"
 
 class VertexSolver : public SolverBase {
 public:
     VertexSolver();
 
+    // Directory to cache the per-blendshape factorizations in. They only depend
+    // on the target neutral and the blendshape's fixed vertices, so re-runs on
+    // the same actor read them back instead of refactoring.
+    void setCacheDir(const std::string &path) { _cacheDir = path; }
+
+    // Single factorizes A^T A in float and refines the solution against the
+    // double system, so the result keeps (close to) double accuracy. The
+    // factor cache is only used in Double.
+    void setRefinementSteps(int steps) { _refinementSteps = steps; }
+
+    // Solves each blendshape over its region of influence only: the vertices
+    // that move in the source blendshape, grown by the given number of rings.
+    // The faces around them are kept, with their remaining vertices pinned to
+    // the neutral; every other vertex is left at the neutral.
+    void setRegionOfInfluence(bool enable, int rings = 2) {
+        _useRegions = enable;
+        _regionRings = rings;
+    }
+
+    // Vertices kept at the neutral, e.g. the border of a masked submesh
+    void setPinnedVertices(const std::vector<int> &vertices) { _pinnedVertices = vertices; }
+
     virtual void init();
 
     virtual bool solve(int iter);
@@ -28,6 +51,7 @@ private:
     typedef Eigen::Matrix<double, 3, 4> MatrixE;
     typedef Eigen::Matrix<double, _Matrix::SizeAtCompileTime, 1> MatrixQ;
     typedef Eigen::SimplicialLDLT<SparseMatrix> Solver;
+    typedef Eigen::SimplicialLDLT<Eigen::SparseMatrix<float>> SolverSingle;
 
     const size_t _mSize;
     const size_t _mCols;
@@ -40,6 +64,13 @@ private:
     const int _maxFixed;
     const bool _randomFixed;
 
+    int _refinementSteps;
+
+    bool _useRegions;
+    int _regionRings;
+
+    std::vector<int> _pinnedVertices;
+
     std::vector<std::vector<int>> _fixedVertices;
 
     class SolverData {
@@ -50,6 +81,12 @@ private:
                 , c()
                 , x()
                 , solver()
+                , factors()
+                , ata()
+                , solverSingle()
+                , regionVertices()
+                , regionFaces()
+                , regionColumns()
             {}
 
         SolverData(const SolverData &other)
@@ -65,14 +102,44 @@ private:
         MatrixX x;
 
         Solver solver;
+
+        // Factors read from the cache; when valid, used instead of the solver
+        LDLTFactors factors;
+
+        // Single precision; A^T A is kept in double for the refinement residuals
+        SparseMatrix ata;
+
+        SolverSingle solverSingle;
+
+        // Region of influence, see setRegionOfInfluence(). The columns map each
+        // vertex to its unknown, or -1 when pinned; empty for a full solve.
+        std::vector<int> regionVertices;
+        std::vector<int> regionFaces;
+        std::vector<int> regionColumns;
+
+        bool hasRegion() const { return !regionColumns.empty(); }
     };
 
     std::vector<SolverData> _solvers;
 
+    std::string _cacheDir;
+
     StepCallback _callback;
 
     bool transfer(Index bs);
 
+    bool transferSingle(Index bs);
+
+    void findRegion(Index bs, SolverData &solver) const;
+
+    void constructA(Index bs, const SolverData &solver, SparseMatrix &a);
+
+    void constructRegionA(Index bs, const SolverData &solver, SparseMatrix &a);
+
+    void constructC(Index bs, SolverData &solver);
+
+    void constructRegionC(Index bs, const SolverData &solver, MatrixX &c);
+
     void constructA(int bs, SparseMatrix &a);
 
     void constructA(Index face, const MatrixE &e, TripletList &m);
@@ -85,15 +152,19 @@ private:
 
     void constructC(Index face, const Matrix3x3 &q, MatrixX &c);
 
+    void constructQ(Index bs, Index face, Matrix3x3 &q) const;
+
     void constructFixedC(Index bs, MatrixX &c);
 
-    void copyTo(Index bs, MatrixX &x) const;
+    void copyTo(Index bs, MatrixX &x, const SolverData &solver) const;
 
     Index vertexIndex(Index idx) const;
 
     void vertexIndices(Index face, Index vertices[]) const;
 
     bool checkSolverError(const Solver &solver) const;
+
+    bool checkSolverError(const SolverSingle &solver) const;
 };
 
 #endif /* VertexSolver_hpp */
@@ -8,20 +8,26 @@
 
 #include "WeightsSolver.h"
 
-#include <thread>
+#include "../shared/Dispatch.h"
+#include "../shared/Parallel.h"
+
 #include <mutex>
 
-int WeightsSolver::WeightsFunctor::operator()(const Eigen::VectorXd &x, Eigen::VectorXd &fvec) const {
+template<typename T, int N>
+int WeightsSolver::WeightsFunctorT<T, N>::operator()(const Eigen::VectorXd &x, Eigen::VectorXd &fvec) const {
     const auto numVertices = a->rows() / 3;
     const auto numWeights = estimateW.size();
 
+    const Eigen::Map<const MatrixA> A(a->data(), a->rows(), a->cols());
+    const VectorW w = x.template cast<T>();
+
     // ||Ax - c||^2
     // where A are the blendshapes, x are the weights, and c is (pose - neutral)
-    MatrixX vDiff = (*a * x).rowwise().sum() - *c;
+    MatrixXT<T> vDiff = (A * w).rowwise().sum() - *c;
     vDiff = vDiff.cwiseProduct(vDiff);
 
     for (auto i = 0; i < numVertices; i++) {
-        const auto sum = vDiff.block<3, 1>(i * 3, 0).sum();
+        const auto sum = vDiff.template block<3, 1>(i * 3, 0).sum();
         fvec(i) = sum;//std::sqrt(sum);
     }
 
@@ -38,11 +44,38 @@ int WeightsSolver::WeightsFunctor::operator()(const Eigen::VectorXd &x, Eigen::V
     return 0;
 }
 
-int WeightsSolver::WeightsFunctor::inputs() const {
+template<typename T, int N>
+int WeightsSolver::WeightsFunctorT<T, N>::df(const Eigen::VectorXd &x, Eigen::MatrixXd &fjac) const {
+    const auto numVertices = a->rows() / 3;
+    const auto numWeights = estimateW.size();
+
+    const Eigen::Map<const MatrixA> A(a->data(), a->rows(), a->cols());
+    const VectorW w = x.template cast<T>();
+
+    const VectorXT<T> vDiff = A * w - *c;
+
+    // d/dx ||A_v x - c_v||^2 = 2 (A_v x - c_v)^T A_v
+    for (auto i = 0; i < numVertices; i++) {
+        fjac.row(i) = (T(2) * vDiff.template segment<3>(i * 3).transpose() * A.template middleRows<3>(i * 3))
+                .template cast<double>();
+    }
+
+    // d/dx lambda (w* - x)^2 = -2 lambda (w* - x)
+    fjac.bottomRows(numWeights).setZero();
+
+    for (auto i = 0; i < numWeights; i++)
+        fjac(i + numVertices, i) = -2 * lambda * (estimateW(i) - x(i));
+
+    return 0;
+}
+
+template<typename T, int N>
+int WeightsSolver::WeightsFunctorT<T, N>::inputs() const {
     return estimateW.size();
 }
 
-int WeightsSolver::WeightsFunctor::values() const {
+template<typename T, int N>
+int WeightsSolver::WeightsFunctorT<T, N>::values() const {
     // #  of vertices + # of weights
     return (a->rows() / 3) + estimateW.size();
 }
@@ -79,6 +112,16 @@ void WeightsSolver::init() {
 
         appendWeightFit(pose, _Cs[pose]);
     }
+
+    _CsSingle.clear();
+
+    if (_precision == Precision::Single) {
+        _CsSingle.resize(_target->numPoses());
+
+        for (auto pose = 0; pose < _target->numPoses(); pose++) {
+            _CsSingle[pose] = _Cs[pose].cast<float>();
+        }
+    }
 }
 
 bool WeightsSolver::solve(int iter) {
@@ -96,6 +139,10 @@ bool WeightsSolver::solve(int iter) {
     // the "A" matrix can be shared with all problems.
     appendWeightFit(0, _a);
 
+    if (_precision == Precision::Single) {
+        _aSingle = _a.cast<float>();
+    }
+
     auto solverOp =
             [this, &logMutex]
                     (int threadId, size_t poseStart, size_t poseEnd) {
@@ -105,90 +152,123 @@ bool WeightsSolver::solve(int iter) {
                     logMutex.unlock();
                 }
 
-                WeightsFunctorNumericalDiff data;
+                DispatchBlendshapes(_target->numBlendshapes(), [&](auto numBS) {
+                    // Weights exclude the neutral/BS0
+                    constexpr auto N = decltype(numBS)::value == Eigen::Dynamic
+                                       ? Eigen::Dynamic : decltype(numBS)::value - 1;
 
-                initSolverData(data);
+                    if (_precision == Precision::Single) {
+                        WeightsFunctorT<float, N> data;
 
-                //appendWeightFit(0, data._a);
+                        solvePoses(data, _aSingle, _CsSingle, poseStart, poseEnd);
+                    } else {
+                        WeightsFunctorNumericalDiffT<N> data;
 
-                auto pose = (Index) poseStart;
+                        solvePoses(data, _a, _Cs, poseStart, poseEnd);
+                    }
+                });
 
-                while (true) {
-                    if (pose >= poseEnd)
-                        break;
+                if (_debug && threadId >= 0) {
+                    logMutex.lock();
+                    std::cout << "Thread [" << threadId << "-WS] Complete" << std::endl;
+                    logMutex.unlock();
+                }
+            };
 
-                    data.a = &_a;
-                    data.c = &_Cs[pose];
+    ParallelSegments(_target->numPoses(), solverOp, _useMultithreaded ? 0 : 1);
 
-                    data.estimateW = _estimateWs[pose];
-                    data.x = _estimateWs[pose];
+    if (_callback != nullptr)
+        _callback(iter, _target, _debugPath);
 
-                    //copyWeightsTo(_target->weights(pose), data.x);
+    return true;
+}
 
-                    Eigen::LevenbergMarquardt<WeightsFunctorNumericalDiff> lm(data);
+void WeightsSolver::initTracking() {
+    const auto rows = _target->numVertices() * Vector3::SizeAtCompileTime;
+    const auto cols = _target->numBlendshapes() - 1;
 
-                    // auto status = lm.minimize(data.x);
+    _a.resize(rows, cols);
 
-                    // Use Eigen's (experimental) Levenberg-Marquardt implementation to
-                    // optimize for the blendshape weights for each pose.
-                    auto status = lm.minimizeInit(data.x);
-                    if (status == Eigen::LevenbergMarquardtSpace::ImproperInputParameters) {
-                        std::cerr << "Weights Solver failed to init" << std::endl;
-                        continue;
-                    }
+    appendWeightFit(0, _a);
+}
 
-                    auto iter = 0;
-                    do {
-                        status = lm.minimizeOneStep(data.x);
+bool WeightsSolver::track(MeshPtr scan, const VectorX &prior, double lambda, VectorX &x) const {
+    VectorX c(_target->numVertices() * Vector3::SizeAtCompileTime);
 
-                        // Hack-ish box constraint
-                        for (auto i = 0; i < data.x.size(); i++) {
-                            data.x(i) = std::clamp(data.x(i), _minWeight, _maxWeight);
-                        }
+    appendWeightFit(scan, c);
 
-                        iter++;
+    WeightsFunctorNumericalDiff data;
 
-                    } while (status == Eigen::LevenbergMarquardtSpace::Running && iter < _maxIterations);
+    data.a = &_a;
+    data.c = &c;
 
-                    copyWeightsTo(data.x, _target->weights(pose));
+    data.estimateW = prior;
+    data.lambda = lambda;
+    data.x = x;
 
-                    pose++;
-                }
+    if (!minimize(data))
+        return false;
 
-                if (_debug && threadId >= 0) {
-                    logMutex.lock();
-                    std::cout << "Thread [" << threadId << "-WS] Complete" << std::endl;
-                    logMutex.unlock();
-                }
-            };
+    x = data.x;
 
-    if (_useMultithreaded) {
-        std::vector<std::thread> pool;
-        const auto size = _target->numPoses();
-        const auto numThreads = std::min(size, (size_t) std::thread::hardware_concurrency());
-        const auto segmentSize = numThreads == size ? 1 : (size / numThreads) + 1;
-        auto segmentStart = 0;
+    return true;
+}
 
-        for (auto i = 0; i < numThreads; i++) {
-            pool.push_back(std::thread(solverOp, i, segmentStart, std::min(segmentStart + segmentSize, size)));
+template<typename Functor, typename Scalar>
+void WeightsSolver::solvePoses(Functor &data, const MatrixXT<Scalar> &a, const std::vector<VectorXT<Scalar>> &cs,
+                               size_t poseStart, size_t poseEnd) {
+    initSolverData(data);
 
-            segmentStart += segmentSize;
-        }
+    //appendWeightFit(0, data._a);
+
+    for (auto pose = (Index) poseStart; pose < poseEnd; pose++) {
+        data.a = &a;
+        data.c = &cs[pose];
 
-        for (auto &thread : pool) {
-            thread.join();
+        data.estimateW = _estimateWs[pose];
+        data.x = _estimateWs[pose];
+
+        //copyWeightsTo(_target->weights(pose), data.x);
+
+        if (!minimize(data)) {
+            std::cerr << "Weights Solver failed to init" << std::endl;
         }
-    } else {
-        solverOp(-1, 0, _target->numPoses());
+
+        copyWeightsTo(data.x, _target->weights(pose));
     }
+}
 
-    if (_callback != nullptr)
-        _callback(iter, _target, _debugPath);
+template<typename Functor>
+bool WeightsSolver::minimize(Functor &data) const {
+    Eigen::LevenbergMarquardt<Functor> lm(data);
+
+    // auto status = lm.minimize(data.x);
+
+    // Use Eigen's (experimental) Levenberg-Marquardt implementation to
+    // optimize for the blendshape weights for each pose.
+    auto status = lm.minimizeInit(data.x);
+    if (status == Eigen::LevenbergMarquardtSpace::ImproperInputParameters) {
+        return false;
+    }
+
+    auto iter = 0;
+    do {
+        status = lm.minimizeOneStep(data.x);
+
+        // Hack-ish box constraint
+        for (auto i = 0; i < data.x.size(); i++) {
+            data.x(i) = std::clamp(data.x(i), _minWeight, _maxWeight);
+        }
+
+        iter++;
+
+    } while (status == Eigen::LevenbergMarquardtSpace::Running && iter < _maxIterations);
 
     return true;
 }
 
-void WeightsSolver::initSolverData(WeightsSolver::WeightsFunctor &data) {
+template<typename Functor>
+void WeightsSolver::initSolverData(Functor &data) {
     // const auto rows = (_target->numVertices() * Vector3::SizeAtCompileTime);
     // const auto cols = _target->numBlendshapes() - 1;
 
@@ -232,7 +312,10 @@ void WeightsSolver::appendWeightFit(Index pose, Index bs, MatrixX &a) {
 }
 
 void WeightsSolver::appendWeightFit(Index pose, VectorX &c) {
-    auto poseMesh = _target->pose(pose).mesh();
+    appendWeightFit(_target->pose(pose).mesh(), c);
+}
+
+void WeightsSolver::appendWeightFit(MeshPtr poseMesh, VectorX &c) const {
     auto neutralMesh = _target->neutral();
 
     for (auto v = 0; v < _target->numVertices(); v++) {
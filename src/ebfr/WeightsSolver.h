@@ -15,9 +15,15 @@
 
 class WeightsSolver : public SolverBase {
 public:
-    struct WeightsFunctor : Eigen::DenseFunctor<double> {
-        MatrixX *a;
-        VectorX *c;
+    // T is the precision of A and c; LM itself (the DenseFunctor's Scalar) stays in double.
+    // N is the number of weights for the fixed-size instances, see Dispatch.h.
+    template<typename T, int N = Eigen::Dynamic>
+    struct WeightsFunctorT : Eigen::DenseFunctor<double> {
+        typedef Eigen::Matrix<T, Eigen::Dynamic, N> MatrixA;
+        typedef Eigen::Matrix<T, N, 1> VectorW;
+
+        const MatrixXT<T> *a;
+        const VectorXT<T> *c;
         //VectorX vDiff;
 
         VectorX estimateW;
@@ -29,14 +35,23 @@ public:
 
         int operator()(const Eigen::VectorXd &x, Eigen::VectorXd &fvec) const;
 
+        // Analytic Jacobian, used in single precision where the
+        // forward-difference step is below the residuals' resolution
+        int df(const Eigen::VectorXd &x, Eigen::MatrixXd &fjac) const;
+
         int inputs() const;
 
         int values() const;
     };
 
-    struct WeightsFunctorNumericalDiff : Eigen::NumericalDiff<WeightsFunctor> {
+    typedef WeightsFunctorT<double> WeightsFunctor;
+
+    template<int N>
+    struct WeightsFunctorNumericalDiffT : Eigen::NumericalDiff<WeightsFunctorT<double, N>> {
     };
 
+    typedef WeightsFunctorNumericalDiffT<Eigen::Dynamic> WeightsFunctorNumericalDiff;
+
     WeightsSolver();
 
     void setLambda(const ParameterD &lambda);
@@ -45,6 +60,15 @@ public:
 
     virtual bool solve(int iter);
 
+    // Tracking - fits weights to individual scans using the target's
+    // (fixed) blendshapes. Only the blendshape matrix is kept, so scans
+    // can be streamed through track() from multiple threads.
+    void initTracking();
+
+    // x holds the starting weights (e.g. the previous frame) and receives the result.
+    // Weights exclude the neutral/BS0 entry. The regularization is lambda * ||x - prior||^2.
+    bool track(MeshPtr scan, const VectorX &prior, double lambda, VectorX &x) const;
+
 private:
     const int _maxIterations;
     const double _minWeight;
@@ -57,9 +81,21 @@ private:
     MatrixX _a;
     std::vector<VectorX> _Cs;
 
+    // Single precision copies of A and the Cs, see setPrecision()
+    Eigen::MatrixXf _aSingle;
+    std::vector<Eigen::VectorXf> _CsSingle;
+
     StepCallback _callback;
 
-    void initSolverData(WeightsFunctor &data);
+    template<typename Functor>
+    void initSolverData(Functor &data);
+
+    template<typename Functor>
+    bool minimize(Functor &data) const;
+
+    template<typename Functor, typename Scalar>
+    void solvePoses(Functor &data, const MatrixXT<Scalar> &a, const std::vector<VectorXT<Scalar>> &cs,
+                    size_t poseStart, size_t poseEnd);
 
     void appendWeightFit(Index Pose, MatrixX &a, VectorX &c);
 
@@ -69,6 +105,8 @@ private:
 
     void appendWeightFit(Index pose, VectorX &c);
 
+    void appendWeightFit(MeshPtr mesh, VectorX &c) const;
+
     void copyWeightsTo(Weights &weights, VectorX &x);
 
     void copyWeightsTo(VectorX &x, Weights &weights);
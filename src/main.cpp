@@ -7,59 +7,96 @@
 //
 
 #include <iostream>
+#include <future>
+#include <mutex>
 
 #include "shared/FS.h"
 #include "shared/CSV.h"
 #include "shared/Timing.h"
+#include "shared/BinaryMatrix.h"
+#include "shared/GLTF.h"
+#include "shared/Reorder.h"
 #include "shared/SolverUtil.h"
 
 #include "ebfr/Rig.h"
+#include "ebfr/RigCache.h"
 #include "ebfr/BlendshapeSolver.h"
 
 #include "Args.h"
 
-void onVertexStep(int iter, RigPtr rig, const std::string &dir) {
-    static MeshPtr temp;
-    if (temp == nullptr)
-        temp = MakeMesh(rig->neutral());
+void onVertexStep(int iter, RigPtr rig, const std::string &dir, bool binary) {
+    if (binary) {
+        const auto &deltas = rig->deltas();
+
+        // Stacked blendshape deltas, one row per blendshape
+        WriteBinaryMatrix(JoinPath(dir, "bs-" + std::to_string(iter) + ".ebfm"), deltas.data(), deltas.cols(), deltas.rows(), true);
+        return;
+    }
 
     const std::string path = dir + "/bs-" + std::to_string(iter) + "-";
     const std::string ext = ".obj";
 
-    for (auto bs = 0; bs < rig->numBlendshapes(); bs++) {
-        AddVertices(rig->blendshape(bs).mesh(), rig->neutral(), 1.0, temp);
+    // Blendshapes are deltas, so the neutral is added back
+    const auto &neutral = rig->neutralPoints();
+
+    MatrixX points(neutral.size(), rig->numBlendshapes());
+    points.col(0) = neutral + neutral;
+    points.rightCols(rig->numBlendshapes() - 1) = rig->deltas().colwise() + neutral;
+
+    std::vector<std::string> paths;
+    std::vector<const double *> positions;
 
-        WriteMesh(path + std::to_string(bs) + ext, temp);
+    for (auto bs = 0; bs < rig->numBlendshapes(); bs++) {
+        paths.push_back(path + std::to_string(bs) + ext);
+        positions.push_back(points.col(bs).data());
     }
+
+    WriteMeshes(paths, positions, rig->topology());
 }
 
-void onWeightsStep(int iter, RigPtr rig, const std::string &dir) {
-    static MeshPtr temp;
-    if (temp == nullptr)
-        temp = MakeMesh(rig->neutral());
+void onWeightsStep(int iter, RigPtr rig, const std::string &dir, bool binary) {
+    if (binary) {
+        WriteBinaryMatrix(JoinPath(dir, "weights-" + std::to_string(iter) + ".ebfm"), rig->weights(), false);
+        return;
+    }
 
     //TIMER_START(WritePoses);
 
     const std::string path = dir + "/pose-" + std::to_string(iter) + "-";
     const std::string ext = ".obj";
 
-    for (auto pose = 0; pose < rig->numPoses(); pose++) {
-        const auto &weights = rig->weights(pose);
-
-        CopyVertices(temp, rig->neutral());
+    MatrixX points;
+    rig->evaluate(rig->weights(), points);
 
-        for (auto bs = 0; bs < rig->numBlendshapes(); bs++) {
-            AddVertices(temp, rig->blendshape(bs).mesh(), weights[bs]);
-        }
+    std::vector<std::string> paths;
+    std::vector<const double *> positions;
 
-        WriteMesh(path + std::to_string(pose) + ext, temp);
+    for (auto pose = 0; pose < rig->numPoses(); pose++) {
+        paths.push_back(path + std::to_string(pose) + ext);
+        positions.push_back(points.col(pose).data());
     }
 
+    WriteMeshes(paths, positions, rig->topology());
+
     PoseCSV::Write(JoinPath(dir, "weights-" + std::to_string(iter) + ".csv"), rig->weights());
 
     //TIMER_END(WritePoses);
 }
 
+// Calculates each of the rig's pose frames as soon as its mesh is read
+void calculateFramesOnLoad(RigPtr rig, GradientsPtr gradients) {
+    auto sized = std::make_shared<std::once_flag>();
+
+    // Poses are read after the neutral, so the rig's topology is already built
+    const auto rigPtr = rig.get();
+
+    rig->setPoseLoadedCallback([rigPtr, gradients, sized](size_t pose, size_t numPoses, MeshPtr mesh) {
+        std::call_once(*sized, [&]() { gradients->resizePoses(numPoses, mesh->n_faces()); });
+
+        gradients->calculatePose(pose, mesh, *rigPtr->topology());
+    });
+}
+
 int main(int argc, char *argv[]) {
     Args args;
     args.read(argc, argv);
@@ -67,39 +104,169 @@ int main(int argc, char *argv[]) {
     Eigen::initParallel();
     //Eigen::setNbThreads(4);
 
-    TIMER_START(LoadSourceRig);
+    TIMER_START(LoadRigs);
 
+    // Loading runs as a small task graph: each rig is read concurrently, each
+    // pose's frames are calculated as soon as its mesh is read, and the source
+    // blendshape frames as soon as the source rig is, while the target poses
+    // may still be loading.
     auto sourceRig = MakeRig();
-    sourceRig->load(args.srcBlendshapeDir, args.srcPoseDir, args.srcWeightsPath, args.vertexMaskPath, false);
+    sourceRig->setIOThreads(args.ioThreads);
 
-    TIMER_END(LoadSourceRig);
+    auto sourceGradients = std::make_shared<Gradients>();
 
-    TIMER_START(LoadTargetRig);
+    // With a cache directory, the source gradients may be restored along with
+    // the rest of the source precomputation in the solver. Reordered and
+    // compacted rigs have their frames calculated once they're final.
+    const bool deferFrames = args.reorder || args.compactMask;
+    const bool calculateSource = args.cacheDir.empty() && !deferFrames;
+
+    if (calculateSource) {
+        calculateFramesOnLoad(sourceRig, sourceGradients);
+    }
+
+    auto sourceLoad = std::async(std::launch::async, [&]() {
+        const auto loaded = args.srcCachePath.empty()
+                ? sourceRig->load(args.srcBlendshapeDir, args.srcPoseDir, args.srcWeightsPath, args.vertexMaskPath, false)
+                : LoadCachedRig(*sourceRig, args.srcCachePath, args.srcBlendshapeDir, args.srcPoseDir, args.srcWeightsPath, args.vertexMaskPath);
+
+        if (loaded && calculateSource) {
+            // Poses restored from a rig cache aren't read as meshes
+            if (sourceGradients->poseM.numShapes() != sourceRig->numPoses()) {
+                sourceGradients->calculate(sourceRig, false);
+            } else {
+                sourceGradients->calculateBlendshapes(sourceRig, false);
+            }
+        }
+
+        return loaded;
+    });
 
     auto targetRig = MakeRig();
-    targetRig->load(args.tgtNeutralPath, args.tgtPoseDir, args.tgtWeightsPath, args.vertexMaskPath, true);
+    targetRig->setIOThreads(args.ioThreads);
+
+    auto targetGradients = std::make_shared<Gradients>();
+
+    if (!deferFrames) {
+        calculateFramesOnLoad(targetRig, targetGradients);
+    }
+
+    auto targetLoad = std::async(std::launch::async, [&]() {
+        return targetRig->load(args.tgtNeutralPath, args.tgtPoseDir, args.tgtWeightsPath, args.vertexMaskPath, true);
+    });
+
+    const auto targetLoaded = targetLoad.get();
+    const auto sourceLoaded = sourceLoad.get();
+
+    if (!sourceLoaded) {
+        std::cerr << "Failed to load source rig" << std::endl;
+        return 1;
+    }
+
+    if (!targetLoaded) {
+        std::cerr << "Failed to load target rig" << std::endl;
+        return 1;
+    }
 
     targetRig->generateEmptyBlendshapes(sourceRig->numBlendshapes());
 
-    TIMER_END(LoadTargetRig);
+    Reordering reordering;
+
+    if (args.reorder) {
+        if (sourceRig->topology()->faces() == targetRig->topology()->faces()) {
+            TIMER_START(Reorder);
+
+            // Both rigs share the target's order, so faces still correspond
+            reordering = MortonReordering(targetRig->neutral(), *targetRig->topology());
+
+            sourceRig->reorder(reordering);
+            targetRig->reorder(reordering);
+
+            TIMER_END(Reorder);
+        } else {
+            std::cerr << "Source and target connectivity differ, not reordering" << std::endl;
+        }
+    }
+
+    // The rigs the solver runs on; the masked submeshes with --compact-mask
+    auto sourceSolve = sourceRig;
+    auto targetSolve = targetRig;
+
+    std::vector<int> pinnedVertices;
+
+    if (args.compactMask) {
+        if (targetRig->vertices().empty()) {
+            std::cerr << "No vertex mask, not compacting" << std::endl;
+        } else if (sourceRig->vertices() != targetRig->vertices() || sourceRig->faces() != targetRig->faces()) {
+            std::cerr << "Source and target masks differ, not compacting" << std::endl;
+        } else {
+            std::vector<int> sourceBoundary;
+
+            sourceSolve = sourceRig->extractMasked(sourceBoundary);
+            targetSolve = targetRig->extractMasked(pinnedVertices);
+
+            std::cout
+                    << "Compacted: " << targetSolve->numVertices() << " / " << targetRig->numVertices(true) << " Vertices, "
+                    << targetSolve->numFaces() << " / " << targetRig->numFaces(true) << " Faces, "
+                    << pinnedVertices.size() << " Pinned" << std::endl;
+        }
+    }
+
+    if (deferFrames) {
+        if (args.cacheDir.empty()) {
+            sourceGradients->calculate(sourceSolve, false);
+        }
+
+        targetGradients->calculate(targetSolve, true);
+    } else {
+        // Rigs without poses never size the pose frames in the callback. The
+        // frames calculated while loading must not go through a resize.
+        const auto &poseM = targetGradients->poseM;
+
+        if (poseM.numShapes() != targetRig->numPoses() || poseM.numFaces() != targetRig->numFaces(true)) {
+            targetGradients->resizePoses(targetRig->numPoses(), targetRig->numFaces(true));
+        }
+
+        targetGradients->calculateBlendshapes(targetRig, true);
+    }
+
+    TIMER_END(LoadRigs);
 
     const auto estWeights = targetRig->weights();
-    targetRig->randomizeWeights();
+    targetSolve->randomizeWeights();
 
     BlendshapeSolver solver;
 
     solver.setDebugPath(args.debugPath);
-    solver.setVertexStepCallback(onVertexStep);
-    solver.setWeightsStepCallback(onWeightsStep);
+    solver.setCacheDir(args.cacheDir);
+    solver.setVertexStepCallback([&args](int iter, RigPtr rig, const std::string &dir) {
+        onVertexStep(iter, rig, dir, args.binary);
+    });
+    solver.setWeightsStepCallback([&args](int iter, RigPtr rig, const std::string &dir) {
+        onWeightsStep(iter, rig, dir, args.binary);
+    });
 
     solver.setMultithreaded(true);
 
-    if (!solver.setSource(sourceRig)) {
+    if (args.single || args.singleVertex) {
+        const auto precision = args.single ? Precision::Single : Precision::Double;
+
+        solver.setPrecision(precision, args.singleVertex ? Precision::Single : Precision::Double);
+        targetSolve->setPrecision(precision);
+    }
+
+    if (args.regionRings >= 0) {
+        solver.setRegionOfInfluence(true, args.regionRings);
+    }
+
+    solver.setPinnedVertices(pinnedVertices);
+
+    if (!solver.setSource(sourceSolve, sourceGradients)) {
         std::cerr << "Failed to set source" << std::endl;
         return 1;
     }
 
-    if (!solver.setTarget(targetRig)) {
+    if (!solver.setTarget(targetSolve, targetGradients)) {
         std::cerr << "Failed to set target" << std::endl;
         return 1;
     }
@@ -109,21 +276,63 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    if (targetSolve != targetRig) {
+        targetRig->insertMasked(*targetSolve);
+    }
+
+    if (!reordering.empty()) {
+        // Outputs are written in the original order
+        targetRig->reorder(reordering.inverse());
+    }
+
     std::cout << "Writing Final Blendshapes..." << std::endl;
 
+    std::vector<std::string> blendshapePaths;
+    std::vector<MeshPtr> blendshapeMeshes;
+
     for (auto i = 1; i < targetRig->numBlendshapes(); i++) {
-        WriteMesh(JoinPath(args.outputPath, std::to_string(i - 1) + ".obj"), targetRig->blendshape(i).mesh());
+        blendshapePaths.push_back(JoinPath(args.outputPath, std::to_string(i - 1) + ".obj"));
+        blendshapeMeshes.push_back(targetRig->blendshape(i).mesh());
     }
 
+    WriteMeshes(blendshapePaths, blendshapeMeshes, targetRig->topology());
+
     std::cout << "Writing Final Poses..." << std::endl;
 
+    MatrixX posePoints;
+    targetRig->evaluate(estWeights, posePoints);
+
+    std::vector<std::string> posePaths;
+    std::vector<const double *> posePositions;
+
     for (auto pose = 0; pose < targetRig->numPoses(); pose++) {
-        WriteMesh(JoinPath(args.outputPath, "pose-" + std::to_string(pose) + ".obj"), targetRig->generatePose(estWeights[pose]));
+        posePaths.push_back(JoinPath(args.outputPath, "pose-" + std::to_string(pose) + ".obj"));
+        posePositions.push_back(posePoints.col(pose).data());
     }
 
+    WriteMeshes(posePaths, posePositions, targetRig->topology());
+
     std::cout << "Writing Final Weights..." << std::endl;
 
     PoseCSV::Write(JoinPath(args.outputPath, "poses.csv"), targetRig->weights());
 
+    if (args.binary) {
+        std::cout << "Writing Binary Outputs..." << std::endl;
+
+        const auto &deltas = targetRig->deltas();
+
+        WriteBinaryMatrix(JoinPath(args.outputPath, "weights.ebfm"), targetRig->weights(), false);
+        WriteBinaryMatrix(JoinPath(args.outputPath, "blendshapes.ebfm"), deltas.data(), deltas.cols(), deltas.rows(), true);
+
+        std::vector<std::string> targetNames;
+        for (auto i = 1; i < targetRig->numBlendshapes(); i++) {
+            targetNames.push_back(std::to_string(i - 1));
+        }
+
+        WriteGLB(JoinPath(args.outputPath, "rig.glb"),
+                 targetRig->neutralPoints().data(), targetRig->numVertices(true), targetRig->topology()->faces(),
+                 deltas.data(), targetNames);
+    }
+
     return 0;
 }
@@ -0,0 +1,109 @@
+//
+//  BinaryMatrix.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "BinaryMatrix.h"
+#include "Endian.h"
+#include "MappedFile.h"
+
+#include <fstream>
+#include <iostream>
+
+const size_t HeaderSize = 4 * sizeof(uint32_t) + 2 * sizeof(uint64_t);
+
+bool WriteBinaryMatrix(const std::string &path, const double *values, size_t rows, size_t cols, bool singlePrecision) {
+    const uint32_t scalarSize = singlePrecision ? sizeof(float) : sizeof(double);
+
+    std::vector<char> buffer;
+    buffer.reserve(HeaderSize + rows * cols * scalarSize);
+
+    AppendLE(buffer, BinaryMatrixMagic);
+    AppendLE(buffer, BinaryMatrixVersion);
+    AppendLE(buffer, scalarSize);
+    AppendLE(buffer, (uint32_t) 0);
+    AppendLE(buffer, (uint64_t) rows);
+    AppendLE(buffer, (uint64_t) cols);
+
+    for (size_t i = 0; i < rows * cols; i++) {
+        if (singlePrecision) {
+            AppendLE(buffer, (float) values[i]);
+        } else {
+            AppendLE(buffer, values[i]);
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+
+    file.write(buffer.data(), buffer.size());
+
+    if (!file.good()) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool WriteBinaryMatrix(const std::string &path, const std::vector<std::vector<double>> &rows, bool singlePrecision) {
+    const auto cols = rows.empty() ? 0 : rows[0].size();
+
+    std::vector<double> values;
+    values.reserve(rows.size() * cols);
+
+    for (const auto &row : rows) {
+        if (row.size() != cols) {
+            std::cerr << "Rows differ in length, can't write " << path << std::endl;
+            return false;
+        }
+
+        values.insert(values.end(), row.begin(), row.end());
+    }
+
+    return WriteBinaryMatrix(path, values.data(), rows.size(), cols, singlePrecision);
+}
+
+bool ReadBinaryMatrix(const std::string &path, std::vector<double> &values, size_t &rows, size_t &cols) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+
+    const auto data = file.data();
+
+    if (file.size() < HeaderSize || ReadLE<uint32_t>(data) != BinaryMatrixMagic ||
+        ReadLE<uint32_t>(data + 4) != BinaryMatrixVersion) {
+        std::cerr << "Invalid binary matrix " << path << std::endl;
+        return false;
+    }
+
+    const auto scalarSize = ReadLE<uint32_t>(data + 8);
+
+    rows = ReadLE<uint64_t>(data + 16);
+    cols = ReadLE<uint64_t>(data + 24);
+
+    if ((scalarSize != sizeof(float) && scalarSize != sizeof(double)) ||
+        file.size() != HeaderSize + rows * cols * scalarSize) {
+        std::cerr << "Invalid binary matrix " << path << std::endl;
+        return false;
+    }
+
+    values.resize(rows * cols);
+
+    auto src = data + HeaderSize;
+
+    for (auto &value : values) {
+        value = scalarSize == sizeof(float) ? ReadLE<float>(src) : ReadLE<double>(src);
+        src += scalarSize;
+    }
+
+    return true;
+}
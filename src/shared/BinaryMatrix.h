@@ -0,0 +1,32 @@
+//
+//  BinaryMatrix.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef BinaryMatrix_hpp
+#define BinaryMatrix_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary matrix (.ebfm)
+// Header: "EBFM", version, scalar size in bytes (4 or 8), reserved (uint32, little-endian),
+//         # of rows, # of columns (uint64, little-endian)
+// Values: # of rows x # of columns float32/float64, row-major, little-endian
+
+const uint32_t BinaryMatrixMagic = 0x4D464245; // EBFM
+const uint32_t BinaryMatrixVersion = 1;
+
+// values: row-major; written as float32 if singlePrecision
+bool WriteBinaryMatrix(const std::string &path, const double *values, size_t rows, size_t cols, bool singlePrecision);
+
+// One row per inner vector, all the same length
+bool WriteBinaryMatrix(const std::string &path, const std::vector<std::vector<double>> &rows, bool singlePrecision);
+
+bool ReadBinaryMatrix(const std::string &path, std::vector<double> &values, size_t &rows, size_t &cols);
+
+#endif /* BinaryMatrix_hpp */
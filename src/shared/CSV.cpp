@@ -7,8 +7,14 @@
 //
 
 #include "CSV.h"
+#include "MappedFile.h"
+#include "Parallel.h"
 
 #include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <sstream>
 
 // trim from start (in place)
@@ -181,3 +187,250 @@ bool PoseCSV::values(std::string &name, std::vector<double> &weights) {
     return true;
 }
 
+bool PoseCSVWriter::open(const std::string &path, size_t numWeights) {
+    _file.open(path);
+
+    if (!_file.is_open())
+        return false;
+
+    // Header
+    _file << "Pose,";
+    for (auto i = 0; i < numWeights; i++) {
+        _file << i << ",";
+    }
+
+    return _file.good();
+}
+
+bool PoseCSVWriter::write(const std::string &name, const std::vector<double> &weights) {
+    _file << std::endl << name << ",";
+
+    for (auto w : weights) {
+        _file << w << ",";
+    }
+
+    return _file.good();
+}
+
+void PoseCSVWriter::close() {
+    if (_file.is_open())
+        _file.close();
+}
+
+static inline bool IsBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *LineEnd(const char *p, const char *end) {
+    auto newline = (const char *) std::memchr(p, '\n', end - p);
+    return newline != nullptr ? newline : end;
+}
+
+// The field's [start, end), without surrounding whitespace; returns the start of the next field
+static inline const char *NextField(const char *p, const char *end, const char *&fieldStart, const char *&fieldEnd) {
+    auto delim = (const char *) std::memchr(p, ',', end - p);
+    if (delim == nullptr)
+        delim = end;
+
+    fieldStart = p;
+    fieldEnd = delim;
+
+    while (fieldStart < fieldEnd && IsBlank(*fieldStart))
+        fieldStart++;
+
+    while (fieldEnd > fieldStart && IsBlank(fieldEnd[-1]))
+        fieldEnd--;
+
+    return delim < end ? delim + 1 : end;
+}
+
+struct PoseTableChunk {
+    std::vector<std::string> names;
+    std::vector<double> weights;
+    std::string error;
+};
+
+// Parses up to maxRows rows of [p, end) into the chunk, returns where it stopped
+static const char *ParseRows(const char *p, const char *end, size_t numWeights, PoseTableChunk &chunk,
+                             size_t maxRows = SIZE_MAX) {
+    const char *fieldStart;
+    const char *fieldEnd;
+
+    while (p < end && chunk.names.size() < maxRows) {
+        const auto lineEnd = LineEnd(p, end);
+
+        auto field = NextField(p, lineEnd, fieldStart, fieldEnd);
+
+        // Blank line
+        if (fieldStart == fieldEnd && field == lineEnd) {
+            p = lineEnd + 1;
+            continue;
+        }
+
+        chunk.names.emplace_back(fieldStart, fieldEnd);
+        chunk.weights.resize(chunk.weights.size() + numWeights, 0.0);
+
+        auto weights = chunk.weights.data() + chunk.weights.size() - numWeights;
+
+        for (auto i = 0; i < numWeights && field < lineEnd; i++) {
+            field = NextField(field, lineEnd, fieldStart, fieldEnd);
+
+            if (fieldStart == fieldEnd)
+                continue;
+
+            const auto result = std::from_chars(fieldStart, fieldEnd, weights[i]);
+
+            if (result.ec != std::errc() || result.ptr != fieldEnd) {
+                chunk.error = "Invalid weight [" + std::string(fieldStart, fieldEnd) + "] for [" + chunk.names.back() + "]";
+                return p;
+            }
+        }
+
+        p = lineEnd + 1;
+    }
+
+    return std::min(p, end);
+}
+
+// Number of columns in the header line [begin, headerEnd), a trailing delimiter is ignored
+static size_t ParseHeader(const char *begin, const char *headerEnd) {
+    const char *fieldStart;
+    const char *fieldEnd;
+
+    size_t numColumns = 0;
+
+    for (auto p = begin; p < headerEnd; numColumns++) {
+        p = NextField(p, headerEnd, fieldStart, fieldEnd);
+
+        // Trailing delimiter
+        if (p == headerEnd && fieldStart == fieldEnd && numColumns > 0)
+            break;
+    }
+
+    return numColumns;
+}
+
+PoseTable::PoseTable()
+: _numWeights(0),
+  _next(nullptr),
+  _failed(false)
+{
+}
+
+bool PoseTable::read(const std::string &path, size_t maxThreads) {
+    _names.clear();
+    _weights.clear();
+    _numWeights = 0;
+
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    const auto begin = file.data();
+    const auto end = begin + file.size();
+
+    // Header
+    const auto headerEnd = LineEnd(begin, end);
+    const auto numColumns = ParseHeader(begin, headerEnd);
+
+    if (numColumns == 0)
+        return false;
+
+    _numWeights = numColumns - 1;
+
+    // Rows, split into chunks of whole lines
+    const auto body = std::min(headerEnd + 1, end);
+
+    const size_t minChunkSize = 1 << 20;
+    const auto numChunks = NumThreads((end - body) / minChunkSize + 1, maxThreads);
+
+    std::vector<const char *> bounds(numChunks + 1, end);
+    bounds[0] = body;
+
+    for (auto i = 1; i < numChunks; i++) {
+        const auto p = std::max(bounds[i - 1], body + (end - body) * i / numChunks);
+        bounds[i] = std::min(LineEnd(p, end) + 1, end);
+    }
+
+    std::vector<PoseTableChunk> chunks(numChunks);
+
+    ParallelForEach(numChunks, [&](size_t i) {
+        ParseRows(bounds[i], bounds[i + 1], _numWeights, chunks[i]);
+    }, maxThreads);
+
+    for (auto &chunk : chunks) {
+        if (!chunk.error.empty()) {
+            std::cerr << chunk.error << " in " << path << std::endl;
+            return false;
+        }
+
+        _names.insert(_names.end(), std::make_move_iterator(chunk.names.begin()), std::make_move_iterator(chunk.names.end()));
+        _weights.insert(_weights.end(), chunk.weights.begin(), chunk.weights.end());
+    }
+
+    return true;
+}
+
+bool PoseTable::open(const std::string &path) {
+    _names.clear();
+    _weights.clear();
+    _numWeights = 0;
+    _failed = false;
+
+    _path = path;
+
+    if (!_file.open(path))
+        return false;
+
+    const auto begin = _file.data();
+    const auto end = begin + _file.size();
+
+    const auto headerEnd = LineEnd(begin, end);
+    const auto numColumns = ParseHeader(begin, headerEnd);
+
+    if (numColumns == 0) {
+        _file.close();
+        return false;
+    }
+
+    _numWeights = numColumns - 1;
+    _next = std::min(headerEnd + 1, end);
+
+    return true;
+}
+
+bool PoseTable::next(size_t maxRows) {
+    if (!_file.isOpen() || _failed)
+        return false;
+
+    // Reuses the previous batch's storage
+    PoseTableChunk chunk;
+    chunk.names.swap(_names);
+    chunk.weights.swap(_weights);
+
+    chunk.names.clear();
+    chunk.weights.clear();
+
+    _next = ParseRows(_next, _file.data() + _file.size(), _numWeights, chunk, std::max<size_t>(1, maxRows));
+
+    chunk.names.swap(_names);
+    chunk.weights.swap(_weights);
+
+    if (!chunk.error.empty()) {
+        std::cerr << chunk.error << " in " << _path << std::endl;
+
+        _failed = true;
+
+        _names.clear();
+        _weights.clear();
+
+        return false;
+    }
+
+    return !_names.empty();
+}
+
+void PoseTable::close() {
+    _file.close();
+    _next = nullptr;
+}
@@ -16,6 +16,8 @@
 #include <vector>
 #include <map>
 
+#include "MappedFile.h"
+
 class CSV {
 public:
     CSV();
@@ -63,4 +65,72 @@ public:
     bool values(std::string &name, std::vector<double> &weights);
 };
 
+// Writes a Pose CSV one row at a time
+class PoseCSVWriter {
+public:
+    bool open(const std::string &path, size_t numWeights);
+
+    bool write(const std::string &name, const std::vector<double> &weights);
+
+    void close();
+
+private:
+    std::ofstream _file;
+};
+
+// A whole Pose CSV, read from a memory map and parsed with from_chars into one
+// contiguous, row-major weights matrix. Large files can be parsed in parallel
+// chunks of rows. A trailing delimiter (as written by PoseCSV::Write) is
+// ignored, empty or missing cells are 0 and blank lines are skipped.
+//
+// For files too large to hold, open() reads only the header and each next()
+// replaces the table's rows with the next batch, so memory is bounded by the
+// batch size rather than the file.
+class PoseTable {
+public:
+    PoseTable();
+
+    bool read(const std::string &path, size_t maxThreads = 1);
+
+    bool open(const std::string &path);
+
+    // Parses up to maxRows more rows; false at the end of the file or on an
+    // invalid weight, see failed()
+    bool next(size_t maxRows);
+
+    bool failed() const { return _failed; }
+
+    void close();
+
+    size_t numRows() const { return _names.size(); }
+
+    // Number of weight columns, excluding the name
+    size_t numWeights() const { return _numWeights; }
+
+    const std::string &name(size_t row) const { return _names[row]; }
+
+    const double *weights(size_t row) const { return _weights.data() + row * _numWeights; }
+
+    const std::vector<std::string> &names() const { return _names; }
+
+    // numRows x numWeights
+    const std::vector<double> &weights() const { return _weights; }
+
+private:
+    size_t _numWeights;
+
+    std::vector<std::string> _names;
+
+    std::vector<double> _weights;
+
+    // Streaming, see open()
+    MappedFile _file;
+
+    std::string _path;
+
+    const char *_next;
+
+    bool _failed;
+};
+
 #endif /* CSV_hpp */
@@ -0,0 +1,78 @@
+//
+//  Dispatch.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef Dispatch_hpp
+#define Dispatch_hpp
+
+#include <Eigen/Core>
+
+#include <initializer_list>
+#include <type_traits>
+#include <utility>
+
+// Blendshape counts, including the neutral, that get fixed-size kernel
+// instances: 52 ARKit shapes and the 150-shape template. Define it
+// (comma-separated) to register other counts.
+#ifndef EBFR_FIXED_BLENDSHAPES
+#define EBFR_FIXED_BLENDSHAPES 53, 151
+#endif
+
+template<int... Sizes>
+struct SizeList {
+};
+
+typedef SizeList<EBFR_FIXED_BLENDSHAPES> FixedBlendshapes;
+
+// Size to use for a fixed-size Size x Size matrix of Scalar; Dynamic when it
+// wouldn't fit Eigen's stack allocation limit
+template<typename Scalar, int Size>
+constexpr int FixedSquareSize() {
+    return Size != Eigen::Dynamic && Size * Size * sizeof(Scalar) <= EIGEN_STACK_ALLOCATION_LIMIT
+           ? Size : Eigen::Dynamic;
+}
+
+template<typename Op>
+auto DispatchSize(size_t size, Op &&op, SizeList<>) {
+    return op(std::integral_constant<int, Eigen::Dynamic>());
+}
+
+// Calls op(std::integral_constant<int, N>()) with the N of the list equal to
+// size, or with Eigen::Dynamic when there's none
+template<typename Op, int Size, int... Sizes>
+auto DispatchSize(size_t size, Op &&op, SizeList<Size, Sizes...>) {
+    if (size == Size)
+        return op(std::integral_constant<int, Size>());
+
+    return DispatchSize(size, std::forward<Op>(op), SizeList<Sizes...>());
+}
+
+// Smallest size of the list in [size, maxSize]; size when there's none
+template<int... Sizes>
+size_t PaddedSize(size_t size, size_t maxSize, SizeList<Sizes...>) {
+    size_t padded = 0;
+
+    for (size_t fixed : std::initializer_list<size_t>{Sizes...}) {
+        if (fixed >= size && fixed <= maxSize && (padded == 0 || fixed < padded))
+            padded = fixed;
+    }
+
+    return padded == 0 ? size : padded;
+}
+
+// Number of blendshapes to pad a system of numBlendshapes to, so it runs a
+// fixed-size instance, without exceeding maxBlendshapes
+inline size_t PaddedBlendshapes(size_t numBlendshapes, size_t maxBlendshapes) {
+    return PaddedSize(numBlendshapes, maxBlendshapes, FixedBlendshapes());
+}
+
+template<typename Op>
+auto DispatchBlendshapes(size_t numBlendshapes, Op &&op) {
+    return DispatchSize(numBlendshapes, std::forward<Op>(op), FixedBlendshapes());
+}
+
+#endif /* Dispatch_hpp */
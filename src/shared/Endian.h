@@ -0,0 +1,68 @@
+//
+//  Endian.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef Endian_hpp
+#define Endian_hpp
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+inline bool IsLittleEndian() {
+    const uint16_t value = 1;
+    return *(const uint8_t *) &value == 1;
+}
+
+// Appends the value's bytes in little-endian order
+template<typename T>
+inline void AppendLE(std::vector<char> &buffer, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+
+    if (IsLittleEndian()) {
+        buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+    } else {
+        buffer.insert(buffer.end(), std::rbegin(bytes), std::rend(bytes));
+    }
+}
+
+// Appends count values in little-endian order
+template<typename T>
+inline void AppendLE(std::vector<char> &buffer, const T *values, size_t count) {
+    if (IsLittleEndian()) {
+        const auto *bytes = (const char *) values;
+        buffer.insert(buffer.end(), bytes, bytes + count * sizeof(T));
+        return;
+    }
+
+    buffer.reserve(buffer.size() + count * sizeof(T));
+
+    for (size_t i = 0; i < count; i++) {
+        AppendLE(buffer, values[i]);
+    }
+}
+
+template<typename T>
+inline T ReadLE(const char *src) {
+    char bytes[sizeof(T)];
+
+    if (IsLittleEndian()) {
+        std::memcpy(bytes, src, sizeof(T));
+    } else {
+        std::reverse_copy(src, src + sizeof(T), bytes);
+    }
+
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+
+    return value;
+}
+
+#endif /* Endian_hpp */
@@ -22,6 +22,18 @@ bool Exists(const std::string &path) {
     return (stat(path.c_str(), &buffer) == 0);
 }
 
+bool FileInfo(const std::string &path, uint64_t &size, int64_t &modified) {
+    struct stat buffer;
+
+    if (stat(path.c_str(), &buffer) != 0)
+        return false;
+
+    size = (uint64_t) buffer.st_size;
+    modified = (int64_t) buffer.st_mtime;
+
+    return true;
+}
+
 bool _ListDir(const std::string &dirPath, std::vector<std::string> *files, std::vector<std::string> *dirs,
               const std::string namePattern = "", bool namesOnly = false) {
     DIR *dirp = opendir(dirPath.c_str());
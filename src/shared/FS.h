@@ -11,11 +11,14 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 //#include "ImageMap.h"
 
 bool Exists(const std::string &path);
 
+bool FileInfo(const std::string &path, uint64_t &size, int64_t &modified);
+
 bool ListAll(const std::string &dirPath, std::vector<std::string> &files, std::vector<std::string> &dirs);
 
 bool ListFiles(const std::string &dirPath, std::vector<std::string> &files);
@@ -58,6 +61,13 @@ inline std::string ReplaceExt(const std::string &path, const std::string &ext) {
     return path.substr(0, index + 1) + ext;
 }
 
+// Whether the path ends in the extension (given without the '.')
+inline bool HasExt(const std::string &path, const std::string &ext) {
+    const auto suffix = "." + ext;
+
+    return path.size() > suffix.size() && path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
 inline std::string RemoveExt(const std::string &path) {
     const auto index = path.find_last_of('.');
 
@@ -0,0 +1,159 @@
+//
+//  GLTF.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "GLTF.h"
+#include "Endian.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+const uint32_t GLBMagic = 0x46546C67; // glTF
+const uint32_t GLBChunkJSON = 0x4E4F534A;
+const uint32_t GLBChunkBIN = 0x004E4942;
+
+const int GLTFFloat = 5126;
+const int GLTFUnsignedInt = 5125;
+const int GLTFArrayBuffer = 34962;
+const int GLTFElementArrayBuffer = 34963;
+
+// Appends the positions as float32, writing their bounds (required for POSITION accessors) to the JSON
+static void AppendPositions(std::vector<char> &bin, std::ostringstream &json, const double *positions, size_t numVertices) {
+    float min[3] = {std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max()};
+    float max[3] = {std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()};
+
+    for (size_t i = 0; i < numVertices * 3; i++) {
+        const auto value = (float) positions[i];
+
+        min[i % 3] = std::min(min[i % 3], value);
+        max[i % 3] = std::max(max[i % 3], value);
+
+        AppendLE(bin, value);
+    }
+
+    json << "\"min\":[" << min[0] << "," << min[1] << "," << min[2] << "],"
+         << "\"max\":[" << max[0] << "," << max[1] << "," << max[2] << "]";
+}
+
+static std::string Escape(const std::string &s) {
+    std::string escaped;
+
+    for (auto c : s) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+
+    return escaped;
+}
+
+bool WriteGLB(const std::string &path,
+              const double *positions, size_t numVertices, const std::vector<int> &faces,
+              const double *deltas, const std::vector<std::string> &targetNames) {
+    const auto numTargets = targetNames.size();
+
+    const auto indicesSize = faces.size() * sizeof(uint32_t);
+    const auto positionsSize = numVertices * 3 * sizeof(float);
+
+    std::vector<char> bin;
+    bin.reserve(indicesSize + positionsSize * (1 + numTargets));
+
+    for (auto index : faces) {
+        AppendLE(bin, (uint32_t) index);
+    }
+
+    std::ostringstream accessors;
+    accessors.precision(9);
+
+    accessors
+            << "{\"bufferView\":0,\"componentType\":" << GLTFUnsignedInt
+            << ",\"count\":" << faces.size() << ",\"type\":\"SCALAR\"}";
+
+    // Accessor 1 is the neutral, 2... the targets
+    for (size_t i = 0; i <= numTargets; i++) {
+        accessors
+                << ",{\"bufferView\":1,\"byteOffset\":" << i * positionsSize
+                << ",\"componentType\":" << GLTFFloat
+                << ",\"count\":" << numVertices << ",\"type\":\"VEC3\",";
+
+        AppendPositions(bin, accessors, i == 0 ? positions : deltas + (i - 1) * numVertices * 3, numVertices);
+
+        accessors << "}";
+    }
+
+    std::ostringstream json;
+
+    json
+            << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"ebfr\"},"
+            << "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],"
+            << "\"nodes\":[{\"mesh\":0}],"
+            << "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":1},\"indices\":0,\"mode\":4,\"targets\":[";
+
+    for (size_t i = 0; i < numTargets; i++) {
+        json << (i > 0 ? "," : "") << "{\"POSITION\":" << i + 2 << "}";
+    }
+
+    json << "]}],\"weights\":[";
+
+    for (size_t i = 0; i < numTargets; i++) {
+        json << (i > 0 ? "," : "") << "0";
+    }
+
+    json << "],\"extras\":{\"targetNames\":[";
+
+    for (size_t i = 0; i < numTargets; i++) {
+        json << (i > 0 ? "," : "") << "\"" << Escape(targetNames[i]) << "\"";
+    }
+
+    json
+            << "]}}],"
+            << "\"accessors\":[" << accessors.str() << "],"
+            << "\"bufferViews\":["
+            << "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" << indicesSize << ",\"target\":" << GLTFElementArrayBuffer << "},"
+            << "{\"buffer\":0,\"byteOffset\":" << indicesSize << ",\"byteLength\":" << positionsSize * (1 + numTargets)
+            << ",\"target\":" << GLTFArrayBuffer << "}],"
+            << "\"buffers\":[{\"byteLength\":" << bin.size() << "}]}";
+
+    // Chunks are padded to 4 bytes; JSON with spaces, binary with zeros
+    auto jsonChunk = json.str();
+    jsonChunk.resize((jsonChunk.size() + 3) / 4 * 4, ' ');
+
+    bin.resize((bin.size() + 3) / 4 * 4, 0);
+
+    std::vector<char> glb;
+    glb.reserve(12 + 8 + jsonChunk.size() + 8 + bin.size());
+
+    AppendLE(glb, GLBMagic);
+    AppendLE(glb, (uint32_t) 2);
+    AppendLE(glb, (uint32_t) (12 + 8 + jsonChunk.size() + 8 + bin.size()));
+
+    AppendLE(glb, (uint32_t) jsonChunk.size());
+    AppendLE(glb, GLBChunkJSON);
+    glb.insert(glb.end(), jsonChunk.begin(), jsonChunk.end());
+
+    AppendLE(glb, (uint32_t) bin.size());
+    AppendLE(glb, GLBChunkBIN);
+    glb.insert(glb.end(), bin.begin(), bin.end());
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open " << path << std::endl;
+        return false;
+    }
+
+    file.write(glb.data(), glb.size());
+
+    if (!file.good()) {
+        std::cerr << "Failed to write " << path << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,25 @@
+//
+//  GLTF.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef GLTF_hpp
+#define GLTF_hpp
+
+#include <string>
+#include <vector>
+
+// Writes a glTF 2.0 binary (.glb) with a single mesh: the neutral as the base
+// geometry and one morph target (POSITION deltas) per blendshape. Target names
+// are stored in mesh.extras.targetNames. Values are written as float32.
+// positions: x, y, z per vertex
+// faces: vertex indices, 3 per face
+// deltas: x, y, z per vertex, one block of # of vertices x 3 per target
+bool WriteGLB(const std::string &path,
+              const double *positions, size_t numVertices, const std::vector<int> &faces,
+              const double *deltas, const std::vector<std::string> &targetNames);
+
+#endif /* GLTF_hpp */
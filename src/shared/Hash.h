@@ -0,0 +1,59 @@
+//
+//  Hash.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef Hash_hpp
+#define Hash_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <iomanip>
+
+const uint64_t HashSeed = 14695981039346656037ull;
+
+// FNV-1a style hash, 8 bytes at a time.
+// For cache keys and corruption checks, not cryptographic use.
+inline uint64_t Hash(const void *data, size_t size, uint64_t hash = HashSeed) {
+    const uint64_t prime = 1099511628211ull;
+
+    const auto *bytes = (const unsigned char *) data;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+
+        hash = (hash ^ word) * prime;
+    }
+
+    for (; i < size; i++) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    return hash;
+}
+
+inline uint64_t Hash(const std::string &s, uint64_t hash = HashSeed) {
+    return Hash(s.data(), s.size(), hash);
+}
+
+template<typename T>
+inline uint64_t HashValue(const T &value, uint64_t hash = HashSeed) {
+    return Hash(&value, sizeof(T), hash);
+}
+
+// Fixed width hex string, e.g. for naming cache files by their key
+inline std::string HashName(uint64_t hash) {
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << hash;
+
+    return name.str();
+}
+
+#endif /* Hash_hpp */
@@ -0,0 +1,68 @@
+//
+//  MappedFile.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "MappedFile.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+: _fd(-1)
+, _data(nullptr)
+, _size(0)
+{
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+    _fd = ::open(path.c_str(), O_RDONLY);
+    if (_fd == -1)
+        return false;
+
+    struct stat buffer;
+    if (fstat(_fd, &buffer) != 0) {
+        close();
+        return false;
+    }
+
+    _size = (size_t) buffer.st_size;
+
+    // Empty files can't be mapped, but are valid
+    if (_size == 0)
+        return true;
+
+    _data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (_data == MAP_FAILED) {
+        _data = nullptr;
+        close();
+        return false;
+    }
+
+    madvise(_data, _size, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (_data != nullptr)
+        munmap(_data, _size);
+
+    if (_fd != -1)
+        ::close(_fd);
+
+    _fd = -1;
+    _data = nullptr;
+    _size = 0;
+}
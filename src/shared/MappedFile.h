@@ -0,0 +1,43 @@
+//
+//  MappedFile.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef MappedFile_hpp
+#define MappedFile_hpp
+
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    ~MappedFile();
+
+    bool open(const std::string &path);
+
+    void close();
+
+    bool isOpen() const { return _fd != -1; }
+
+    const char *data() const { return (const char *) _data; }
+
+    size_t size() const { return _size; }
+
+private:
+    int _fd;
+
+    void *_data;
+
+    size_t _size;
+};
+
+#endif /* MappedFile_hpp */
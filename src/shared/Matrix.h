@@ -34,6 +34,18 @@ typedef Eigen::Vector4d Vector4;
 typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic> MatrixX;
 typedef Eigen::Matrix<double, Eigen::Dynamic, 1> VectorX;
 
+// Scalar type of the stages that can run in single precision
+enum class Precision {
+    Double,
+    Single
+};
+
+template<typename Scalar>
+using MatrixXT = Eigen::Matrix<Scalar, Eigen::Dynamic, Eigen::Dynamic>;
+
+template<typename Scalar>
+using VectorXT = Eigen::Matrix<Scalar, Eigen::Dynamic, 1>;
+
 
 #ifndef EPS
 #define EPS 0.0001
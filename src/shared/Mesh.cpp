@@ -7,19 +7,107 @@
 //
 
 #include "Mesh.h"
+#include "OBJ.h"
+#include "Parallel.h"
 
-MeshPtr ReadMesh(const std::string &path, bool exitOnFail) {
+#include <atomic>
+#include <mutex>
+
+// OpenMesh's IO manager and its readers/writers are process-wide singletons
+// that keep per-call state, so every read_mesh/write_mesh is serialized.
+// Rig meshes read over a shared topology (ReadOBJ) don't go through it.
+static std::mutex OpenMeshIOMutex;
+
+static std::vector<int> FaceList(const Mesh &mesh) {
+    std::vector<int> faces;
+    faces.reserve(mesh.n_faces() * 3);
+
+    Mesh::VertexHandle vertices[3];
+
+    for (auto faceIter = mesh.faces_begin(), faceEnd = mesh.faces_end(); faceIter != faceEnd; faceIter++) {
+        FaceVertices(mesh, *faceIter, vertices);
+
+        for (auto &v : vertices) {
+            faces.emplace_back(v.idx());
+        }
+    }
+
+    return faces;
+}
+
+Topology::Topology(MeshPtr mesh)
+: _mesh(mesh)
+, _faces(FaceList(*mesh))
+, _writer(_faces, mesh->n_vertices())
+{
+    buildVertexFaces();
+}
+
+void Topology::buildVertexFaces() {
+    const auto numV = numVertices();
+
+    _vertexFaceOffsets.assign(numV + 1, 0);
+
+    for (auto v : _faces) {
+        _vertexFaceOffsets[v + 1]++;
+    }
+
+    for (auto v = 0; v < numV; v++) {
+        _vertexFaceOffsets[v + 1] += _vertexFaceOffsets[v];
+    }
+
+    _vertexFaces.resize(_faces.size());
+
+    // Faces are visited in order, so each vertex's faces end up sorted
+    auto next = _vertexFaceOffsets;
+
+    for (auto i = 0; i < _faces.size(); i++) {
+        _vertexFaces[next[_faces[i]]++] = (int) (i / 3);
+    }
+}
+
+MeshPtr BuildMesh(const double *positions, size_t numVertices, const int *faces, size_t numFaces, MeshProfile profile) {
+    auto mesh = MakeMesh();
+
+    for (auto i = 0; i < numVertices; i++, positions += 3) {
+        mesh->add_vertex(Mesh::Point(positions[0], positions[1], positions[2]));
+    }
+
+    for (auto i = 0; i < numFaces; i++, faces += 3) {
+        mesh->add_face(mesh->vertex_handle(faces[0]), mesh->vertex_handle(faces[1]), mesh->vertex_handle(faces[2]));
+    }
+
+    if (profile == MeshProfile::Full) {
+        UpdateNormals(mesh);
+    }
+
+    return mesh;
+}
+
+MeshPtr ReadMesh(const std::string &path, bool exitOnFail, MeshProfile profile) {
     auto mesh = MakeMesh();
 
     Mesh &meshRef = *mesh;
 
-    meshRef.request_face_normals();
-    meshRef.request_vertex_normals();
-    //meshRef.request_vertex_texcoord();
+    OpenMesh::IO::Options opts;
+
+    if (profile == MeshProfile::Full) {
+        meshRef.request_face_normals();
+        meshRef.request_vertex_normals();
+        //meshRef.request_vertex_texcoord();
+
+        opts = OpenMesh::IO::Options(OpenMesh::IO::Options::VertexNormal | OpenMesh::IO::Options::FaceNormal |
+                                     OpenMesh::IO::Options::VertexTexCoord);
+    }
+
+    bool isRead;
 
-    OpenMesh::IO::Options opts(OpenMesh::IO::Options::VertexNormal | OpenMesh::IO::Options::FaceNormal |
-                               OpenMesh::IO::Options::VertexTexCoord);
-    if (!OpenMesh::IO::read_mesh(meshRef, path, opts)) {
+    {
+        std::lock_guard<std::mutex> lock(OpenMeshIOMutex);
+        isRead = OpenMesh::IO::read_mesh(meshRef, path, opts);
+    }
+
+    if (!isRead) {
         std::cerr << "Failed to read mesh at [" << path << "]" << std::endl;
 
         if (exitOnFail)
@@ -28,17 +116,97 @@ MeshPtr ReadMesh(const std::string &path, bool exitOnFail) {
         return nullptr;
     }
 
-    meshRef.update_face_normals();
-    meshRef.update_vertex_normals();
+    if (profile == MeshProfile::Full) {
+        meshRef.update_face_normals();
+        meshRef.update_vertex_normals();
+    }
 
     return mesh;
 }
 
-bool WriteMesh(const std::string &path, MeshPtr mesh) {
-    if (!OpenMesh::IO::write_mesh(*mesh, path)) {
+MeshPtr ReadMesh(const std::string &path, TopologyPtr topology, bool exitOnFail) {
+    std::vector<double> positions;
+    std::vector<int> faces;
+
+    if (!ReadOBJ(path, positions, &faces)) {
+        std::cerr << "Failed to read mesh at [" << path << "]" << std::endl;
+
+        if (exitOnFail)
+            exit(1);
+
+        return nullptr;
+    }
+
+    if (positions.size() != topology->numVertices() * 3 || faces != topology->faces()) {
+        std::cerr << "Mesh at [" << path << "] does not match the shared topology, reading in full" << std::endl;
+
+        return ReadMesh(path, exitOnFail, topology->mesh()->has_vertex_normals() ? MeshProfile::Full : MeshProfile::Light);
+    }
+
+    auto mesh = MakeMesh(topology->mesh());
+
+    CopyVertices(mesh, positions.data());
+
+    if (mesh->has_vertex_normals()) {
+        mesh->update_face_normals();
+        mesh->update_vertex_normals();
+    }
+
+    return mesh;
+}
+
+void UpdateNormals(MeshPtr mesh) {
+    if (!mesh->has_face_normals())
+        mesh->request_face_normals();
+
+    if (!mesh->has_vertex_normals())
+        mesh->request_vertex_normals();
+
+    mesh->update_face_normals();
+    mesh->update_vertex_normals();
+}
+
+bool WriteMesh(const std::string &path, MeshPtr mesh, bool normals) {
+    OpenMesh::IO::Options opts;
+
+    if (normals) {
+        UpdateNormals(mesh);
+
+        opts = OpenMesh::IO::Options(OpenMesh::IO::Options::VertexNormal);
+    }
+
+    bool isWritten;
+
+    {
+        std::lock_guard<std::mutex> lock(OpenMeshIOMutex);
+        isWritten = OpenMesh::IO::write_mesh(*mesh, path, opts);
+    }
+
+    if (!isWritten) {
         std::cerr << "Failed to write mesh to [" << path << "]" << std::endl;
         return false;
     }
 
     return true;
 }
+
+bool WriteMeshes(const std::vector<std::string> &paths, const std::vector<const double *> &positions, TopologyPtr topology, size_t maxThreads) {
+    std::atomic<bool> success(true);
+
+    ParallelForEach(paths.size(), [&](size_t i) {
+        if (!topology->writer().write(paths[i], positions[i]))
+            success = false;
+    }, maxThreads);
+
+    return success;
+}
+
+bool WriteMeshes(const std::vector<std::string> &paths, const std::vector<MeshPtr> &meshes, TopologyPtr topology, size_t maxThreads) {
+    std::vector<const double *> positions(meshes.size());
+
+    for (auto i = 0; i < meshes.size(); i++) {
+        positions[i] = meshes[i]->points()->data();
+    }
+
+    return WriteMeshes(paths, positions, topology, maxThreads);
+}
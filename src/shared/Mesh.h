@@ -13,6 +13,8 @@
 
 #include <OpenMesh/Core/Mesh/TriMesh_ArrayKernelT.hh>
 
+#include "OBJ.h"
+
 #include <memory>
 
 #include <iostream>
@@ -107,6 +109,26 @@ inline void CopyVertices(MeshPtr target, MeshPtr source, double weight) {
     }
 }
 
+inline void CopyVertices(MeshPtr target, const double *src) {
+    auto *dest = target->points();
+
+    for (auto i = 0; i < target->n_vertices(); i++, src += 3) {
+        dest[i] = Mesh::Point(src[0], src[1], src[2]);
+    }
+}
+
+inline void CopyVertices(double *target, MeshPtr source) {
+    const auto *src = source->points();
+
+    for (auto i = 0; i < source->n_vertices(); i++, target += 3) {
+        const auto &p = src[i];
+
+        target[0] = p[0];
+        target[1] = p[1];
+        target[2] = p[2];
+    }
+}
+
 inline void AddVertices(MeshPtr base, MeshPtr modifier, double weight, MeshPtr dest = nullptr) {
     if (dest == nullptr)
         dest = base;
@@ -131,8 +153,82 @@ inline void AddVertices(MeshPtr base, MeshPtr modifier, double weight, MeshPtr d
     }
 }
 
-MeshPtr ReadMesh(const std::string &path, bool exitOnFail = true);
+// Connectivity shared by all of the meshes of a rig.
+// Built once from a reference mesh (the neutral), so that the other
+// meshes can be read as positions only.
+class Topology {
+public:
+    Topology(MeshPtr mesh);
+
+    MeshPtr mesh() const { return _mesh; }
+
+    size_t numVertices() const { return _mesh->n_vertices(); }
+
+    size_t numFaces() const { return _faces.size() / 3; }
+
+    // Face vertex indices, 3 per face
+    const std::vector<int> &faces() const { return _faces; }
+
+    // Vertex indices of a face
+    const int *face(size_t face) const { return _faces.data() + face * 3; }
+
+    // Faces using a vertex, in ascending order (CSR adjacency)
+    const int *vertexFaces(size_t vertex) const { return _vertexFaces.data() + _vertexFaceOffsets[vertex]; }
+
+    size_t numVertexFaces(size_t vertex) const { return _vertexFaceOffsets[vertex + 1] - _vertexFaceOffsets[vertex]; }
+
+    // Writer with the face section already formatted
+    const OBJWriter &writer() const { return _writer; }
+
+private:
+    MeshPtr _mesh;
+
+    std::vector<int> _faces;
+
+    std::vector<int> _vertexFaceOffsets;
+    std::vector<int> _vertexFaces;
+
+    OBJWriter _writer;
+
+    void buildVertexFaces();
+};
+
+typedef std::shared_ptr<Topology> TopologyPtr;
+
+inline TopologyPtr MakeTopology(MeshPtr mesh) {
+    return std::make_shared<Topology>(mesh);
+}
+
+// What's built for a mesh besides its positions and connectivity.
+// Light skips the normal and texcoord attributes, which none of the solvers
+// use; they're computed by UpdateNormals (or WriteMesh) when needed.
+enum class MeshProfile {
+    Full,
+    Light
+};
+
+// Builds a mesh (and its connectivity) from positions (x, y, z per vertex)
+// and face vertex indices (3 per face)
+MeshPtr BuildMesh(const double *positions, size_t numVertices, const int *faces, size_t numFaces,
+                  MeshProfile profile = MeshProfile::Full);
+
+MeshPtr ReadMesh(const std::string &path, bool exitOnFail = true, MeshProfile profile = MeshProfile::Full);
+
+// Reads only the positions of an OBJ file and copies them into a copy of the
+// topology's mesh. Falls back to a full read if the faces don't match.
+// Normals are only computed if the topology's mesh has them.
+MeshPtr ReadMesh(const std::string &path, TopologyPtr topology, bool exitOnFail = true);
+
+// Adds the normal attributes if the mesh doesn't have them, and computes them
+void UpdateNormals(MeshPtr mesh);
+
+// Vertex normals are computed (see UpdateNormals) and written if requested
+bool WriteMesh(const std::string &path, MeshPtr mesh, bool normals = false);
+
+// Writes meshes sharing the topology as OBJ files, in parallel.
+// positions: x, y, z per vertex, one array per path
+bool WriteMeshes(const std::vector<std::string> &paths, const std::vector<const double *> &positions, TopologyPtr topology, size_t maxThreads = 0);
 
-bool WriteMesh(const std::string &path, MeshPtr mesh);
+bool WriteMeshes(const std::vector<std::string> &paths, const std::vector<MeshPtr> &meshes, TopologyPtr topology, size_t maxThreads = 0);
 
 #endif /* Mesh_h */
@@ -0,0 +1,172 @@
+//
+//  OBJ.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "OBJ.h"
+#include "MappedFile.h"
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+
+static inline bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skipSpace(const char *p, const char *end) {
+    while (p < end && isSpace(*p))
+        p++;
+    return p;
+}
+
+static inline const char *skipToken(const char *p, const char *end) {
+    while (p < end && !isSpace(*p) && *p != '\n')
+        p++;
+    return p;
+}
+
+static inline const char *nextLine(const char *p, const char *end) {
+    while (p < end && *p != '\n')
+        p++;
+    return p < end ? p + 1 : end;
+}
+
+bool ReadOBJ(const std::string &path, std::vector<double> &positions, std::vector<int> *faces) {
+    MappedFile file;
+    if (!file.open(path))
+        return false;
+
+    positions.clear();
+    if (faces != nullptr)
+        faces->clear();
+
+    const char *p = file.data();
+    const char *end = p + file.size();
+
+    while (p < end) {
+        p = skipSpace(p, end);
+
+        if (end - p > 2 && p[0] == 'v' && isSpace(p[1])) {
+            p += 2;
+
+            for (auto i = 0; i < 3; i++) {
+                double v;
+
+                p = skipSpace(p, end);
+
+                const auto result = std::from_chars(p, end, v);
+                if (result.ec != std::errc())
+                    return false;
+
+                positions.emplace_back(v);
+                p = result.ptr;
+            }
+        } else if (faces != nullptr && end - p > 2 && p[0] == 'f' && isSpace(p[1])) {
+            p += 2;
+
+            const auto numVertices = (int) (positions.size() / 3);
+
+            int corners = 0;
+            int first = 0, previous = 0;
+
+            while (true) {
+                p = skipSpace(p, end);
+                if (p >= end || *p == '\n' || *p == '#')
+                    break;
+
+                int index;
+
+                const auto result = std::from_chars(p, end, index);
+                if (result.ec != std::errc())
+                    return false;
+
+                p = skipToken(result.ptr, end);
+
+                // 1-based, or relative to the last vertex when negative
+                index = index < 0 ? numVertices + index : index - 1;
+
+                // Polygons are fanned into triangles
+                if (corners == 0) {
+                    first = index;
+                } else if (corners >= 2) {
+                    faces->emplace_back(first);
+                    faces->emplace_back(previous);
+                    faces->emplace_back(index);
+                }
+
+                previous = index;
+                corners++;
+            }
+        }
+
+        p = nextLine(p, end);
+    }
+
+    return true;
+}
+
+OBJWriter::OBJWriter(const std::vector<int> &faces, size_t numVertices)
+: _numVertices(numVertices)
+{
+    _header = "# " + std::to_string(numVertices) + " vertices, " + std::to_string(faces.size() / 3) + " faces\n";
+
+    // "f " + 3 x (index + separator)
+    _faces.resize(faces.size() / 3 * (2 + 3 * 11));
+
+    auto p = _faces.data();
+    const auto end = p + _faces.size();
+
+    for (auto i = 0; i < faces.size(); i += 3) {
+        *p++ = 'f';
+
+        for (auto j = 0; j < 3; j++) {
+            *p++ = ' ';
+            p = std::to_chars(p, end, faces[i + j] + 1).ptr;
+        }
+
+        *p++ = '\n';
+    }
+
+    _faces.resize(p - _faces.data());
+}
+
+bool OBJWriter::write(const std::string &path, const double *positions) const {
+    // "v " + 3 x (value + separator); 24 characters covers any double
+    std::string buffer(_numVertices * (2 + 3 * 25), '\0');
+
+    auto p = buffer.data();
+    const auto end = p + buffer.size();
+
+    for (auto i = 0; i < _numVertices; i++, positions += 3) {
+        *p++ = 'v';
+
+        for (auto j = 0; j < 3; j++) {
+            *p++ = ' ';
+            p = std::to_chars(p, end, positions[j]).ptr;
+        }
+
+        *p++ = '\n';
+    }
+
+    auto file = std::fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        std::cerr << "Failed to write mesh to [" << path << "]" << std::endl;
+        return false;
+    }
+
+    auto success = std::fwrite(_header.data(), 1, _header.size(), file) == _header.size();
+    success = success && std::fwrite(buffer.data(), 1, p - buffer.data(), file) == (size_t) (p - buffer.data());
+    success = success && std::fwrite(_faces.data(), 1, _faces.size(), file) == _faces.size();
+
+    success = (std::fclose(file) == 0) && success;
+
+    if (!success) {
+        std::cerr << "Failed to write mesh to [" << path << "]" << std::endl;
+    }
+
+    return success;
+}
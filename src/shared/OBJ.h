@@ -0,0 +1,39 @@
+//
+//  OBJ.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef OBJ_hpp
+#define OBJ_hpp
+
+#include <string>
+#include <vector>
+
+// Reads the vertex positions (x, y, z per vertex) and, if requested, the
+// triangle vertex indices (0-based, 3 per face) of an OBJ file.
+// Texture/normal indices and all other statements are ignored.
+bool ReadOBJ(const std::string &path, std::vector<double> &positions, std::vector<int> *faces = nullptr);
+
+// Writes OBJ files (positions and triangles only) for meshes sharing a topology.
+// The face section is formatted once, on construction; positions are written
+// with the shortest representation that reads back exactly.
+// write is const and can be called from multiple threads.
+class OBJWriter {
+public:
+    OBJWriter(const std::vector<int> &faces, size_t numVertices);
+
+    // positions: x, y, z per vertex
+    bool write(const std::string &path, const double *positions) const;
+
+private:
+    size_t _numVertices;
+
+    std::string _header;
+
+    std::string _faces;
+};
+
+#endif /* OBJ_hpp */
@@ -0,0 +1,87 @@
+//
+//  Parallel.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef Parallel_hpp
+#define Parallel_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+inline size_t NumThreads(size_t size, size_t maxThreads = 0) {
+    size_t numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+    if (maxThreads > 0)
+        numThreads = std::min(numThreads, maxThreads);
+
+    return std::max((size_t) 1, std::min(numThreads, size));
+}
+
+// Splits [0, size) into one contiguous segment per thread and runs
+// op(threadId, start, end) on each, as the solver loops do.
+// Runs op(-1, 0, size) on the calling thread when only one segment is needed.
+template<typename Op>
+void ParallelSegments(size_t size, const Op &op, size_t maxThreads = 0) {
+    const auto numThreads = NumThreads(size, maxThreads);
+
+    if (numThreads <= 1) {
+        op(-1, (size_t) 0, size);
+        return;
+    }
+
+    std::vector<std::thread> pool;
+
+    const auto segmentSize = (size + numThreads - 1) / numThreads;
+    size_t segmentStart = 0;
+
+    for (auto i = 0; i < numThreads && segmentStart < size; i++) {
+        pool.push_back(std::thread(op, i, segmentStart, std::min(segmentStart + segmentSize, size)));
+
+        segmentStart += segmentSize;
+    }
+
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+// Runs op(index) for every index in [0, size) on at most maxThreads threads.
+// Indices are handed out one at a time, so uneven tasks (e.g. file reads)
+// balance across the threads; results should be written to slot [index]
+// to keep the output order deterministic.
+template<typename Op>
+void ParallelForEach(size_t size, const Op &op, size_t maxThreads = 0) {
+    const auto numThreads = NumThreads(size, maxThreads);
+
+    if (numThreads <= 1) {
+        for (size_t i = 0; i < size; i++)
+            op(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+
+    auto worker = [&]() {
+        for (auto i = next++; i < size; i = next++) {
+            op(i);
+        }
+    };
+
+    std::vector<std::thread> pool;
+
+    for (auto i = 0; i < numThreads; i++) {
+        pool.push_back(std::thread(worker));
+    }
+
+    for (auto &thread : pool) {
+        thread.join();
+    }
+}
+
+#endif /* Parallel_hpp */
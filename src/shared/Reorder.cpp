@@ -0,0 +1,151 @@
+//
+//  Reorder.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include "Reorder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+
+static std::vector<int> InverseOrder(const std::vector<int> &order) {
+    std::vector<int> index(order.size());
+
+    for (auto i = 0; i < order.size(); i++) {
+        index[order[i]] = i;
+    }
+
+    return index;
+}
+
+Reordering::Reordering(std::vector<int> vertexOrder, std::vector<int> faceOrder)
+: _vertexOrder(std::move(vertexOrder))
+, _faceOrder(std::move(faceOrder))
+, _vertexIndex(InverseOrder(_vertexOrder))
+, _faceIndex(InverseOrder(_faceOrder))
+{
+}
+
+Reordering Reordering::inverse() const {
+    return Reordering(_vertexIndex, _faceIndex);
+}
+
+void Reordering::permutePoints(const Mesh::Point *points, double *dest) const {
+    for (auto i = 0; i < _vertexOrder.size(); i++, dest += 3) {
+        const auto &p = points[_vertexOrder[i]];
+
+        dest[0] = p[0];
+        dest[1] = p[1];
+        dest[2] = p[2];
+    }
+}
+
+std::vector<int> Reordering::permuteFaces(const std::vector<int> &faces) const {
+    std::vector<int> permuted(faces.size());
+
+    for (auto i = 0; i < _faceOrder.size(); i++) {
+        const auto face = faces.data() + _faceOrder[i] * 3;
+
+        for (auto j = 0; j < 3; j++) {
+            permuted[i * 3 + j] = _vertexIndex[face[j]];
+        }
+    }
+
+    return permuted;
+}
+
+static std::vector<int> PermuteList(const std::vector<int> &list, const std::vector<int> &index, bool sort = true) {
+    std::vector<int> permuted(list.size());
+
+    for (auto i = 0; i < list.size(); i++) {
+        permuted[i] = index[list[i]];
+    }
+
+    if (sort) {
+        std::sort(permuted.begin(), permuted.end());
+    }
+
+    return permuted;
+}
+
+std::vector<int> Reordering::permuteVertexList(const std::vector<int> &vertices, bool sort) const {
+    return PermuteList(vertices, _vertexIndex, sort);
+}
+
+std::vector<int> Reordering::permuteFaceList(const std::vector<int> &faces) const {
+    return PermuteList(faces, _faceIndex);
+}
+
+// Spreads the low 21 bits of v to every third bit
+static uint64_t SpreadBits(uint64_t v) {
+    v &= 0x1fffff;
+    v = (v | (v << 32)) & 0x1f00000000ffffULL;
+    v = (v | (v << 16)) & 0x1f0000ff0000ffULL;
+    v = (v | (v << 8)) & 0x100f00f00f00f00fULL;
+    v = (v | (v << 4)) & 0x10c30c30c30c30c3ULL;
+    v = (v | (v << 2)) & 0x1249249249249249ULL;
+
+    return v;
+}
+
+Reordering MortonReordering(MeshPtr mesh, const Topology &topology) {
+    const auto numV = mesh->n_vertices();
+    const auto points = mesh->points();
+
+    Mesh::Point min = numV > 0 ? points[0] : Mesh::Point(0, 0, 0);
+    Mesh::Point max = min;
+
+    for (auto i = 0; i < numV; i++) {
+        for (auto j = 0; j < 3; j++) {
+            min[j] = std::min(min[j], points[i][j]);
+            max[j] = std::max(max[j], points[i][j]);
+        }
+    }
+
+    const double cells = (1 << 21) - 1;
+
+    std::vector<uint64_t> codes(numV);
+
+    for (auto i = 0; i < numV; i++) {
+        uint64_t code = 0;
+
+        for (auto j = 0; j < 3; j++) {
+            const auto extent = max[j] - min[j];
+            const auto cell = extent > 0 ? (uint64_t) ((points[i][j] - min[j]) / extent * cells) : 0;
+
+            code |= SpreadBits(cell) << j;
+        }
+
+        codes[i] = code;
+    }
+
+    std::vector<int> vertexOrder(numV);
+    std::iota(vertexOrder.begin(), vertexOrder.end(), 0);
+
+    std::stable_sort(vertexOrder.begin(), vertexOrder.end(), [&codes](int a, int b) {
+        return codes[a] < codes[b];
+    });
+
+    const auto vertexIndex = InverseOrder(vertexOrder);
+
+    std::vector<int> faceKeys(topology.numFaces());
+
+    for (auto f = 0; f < topology.numFaces(); f++) {
+        const auto face = topology.face(f);
+
+        faceKeys[f] = std::min({vertexIndex[face[0]], vertexIndex[face[1]], vertexIndex[face[2]]});
+    }
+
+    std::vector<int> faceOrder(topology.numFaces());
+    std::iota(faceOrder.begin(), faceOrder.end(), 0);
+
+    std::stable_sort(faceOrder.begin(), faceOrder.end(), [&faceKeys](int a, int b) {
+        return faceKeys[a] < faceKeys[b];
+    });
+
+    return Reordering(std::move(vertexOrder), std::move(faceOrder));
+}
@@ -0,0 +1,67 @@
+//
+//  Reorder.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef Reorder_hpp
+#define Reorder_hpp
+
+#include "Mesh.h"
+
+#include <vector>
+
+// Permutation of a mesh's vertices and faces, e.g. for cache locality.
+// Orders map new indices to old ones; the face corners keep their order, so
+// applying the inverse restores the original connectivity exactly.
+class Reordering {
+public:
+    Reordering() = default;
+
+    Reordering(std::vector<int> vertexOrder, std::vector<int> faceOrder);
+
+    bool empty() const { return _vertexOrder.empty(); }
+
+    size_t numVertices() const { return _vertexOrder.size(); }
+
+    size_t numFaces() const { return _faceOrder.size(); }
+
+    // Old vertex index of each new vertex
+    const std::vector<int> &vertexOrder() const { return _vertexOrder; }
+
+    // Old face index of each new face
+    const std::vector<int> &faceOrder() const { return _faceOrder; }
+
+    // New index of an old vertex
+    int vertexIndex(int vertex) const { return _vertexIndex[vertex]; }
+
+    Reordering inverse() const;
+
+    // Positions (x, y, z per vertex) in the new order
+    void permutePoints(const Mesh::Point *points, double *dest) const;
+
+    // Face vertex indices (3 per face) in the new order, with new vertex indices
+    std::vector<int> permuteFaces(const std::vector<int> &faces) const;
+
+    // New indices of a list of old vertices, sorted or in the list's order
+    std::vector<int> permuteVertexList(const std::vector<int> &vertices, bool sort = true) const;
+
+    // Sorted new indices of a sorted list of old faces
+    std::vector<int> permuteFaceList(const std::vector<int> &faces) const;
+
+private:
+    std::vector<int> _vertexOrder;
+    std::vector<int> _faceOrder;
+
+    std::vector<int> _vertexIndex;
+    std::vector<int> _faceIndex;
+};
+
+// Vertices along a Morton (Z-order) curve through the mesh's bounding box, so
+// vertices that are close in space are close in memory. Faces follow their
+// lowest new vertex index.
+Reordering MortonReordering(MeshPtr mesh, const Topology &topology);
+
+#endif /* Reorder_hpp */
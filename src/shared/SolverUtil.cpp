@@ -10,6 +10,9 @@
 
 #include "Util.h"
 
+#include <algorithm>
+#include <cmath>
+
 void CalculateSurface(const Mesh &ref, const Mesh::FaceHandle &refFace, Matrix3x3 &s) {
     ConstructTriangleNormMatrix(ref, refFace, s);
 }
@@ -69,4 +72,138 @@ void GenerateEmptyFrames(MeshPtr mesh, std::vector<Matrix3x3> &gradients) {
     for (auto &m : gradients) {
         m.setZero();
     }
-}
\ No newline at end of file
+}
+
+// Faces per batch; a batch's SoA arrays stay within L1
+static const size_t FrameBatchSize = 64;
+
+static size_t CalculateFrames(MeshPtr mesh, const Topology &topology,
+                              TensorView<Matrix3x3> &frames, TensorView<Matrix3x3> *invFrames) {
+    const auto points = mesh->points();
+    const auto numFaces = topology.numFaces();
+
+    // Columns of the frames, [component][face]
+    alignas(64) double e0[3][FrameBatchSize];
+    alignas(64) double e1[3][FrameBatchSize];
+    alignas(64) double n[3][FrameBatchSize];
+
+    alignas(64) double inv[9][FrameBatchSize];
+    alignas(64) bool zero[FrameBatchSize];
+    alignas(64) bool singular[FrameBatchSize];
+
+    size_t numDegenerate = 0;
+
+    for (size_t start = 0; start < numFaces; start += FrameBatchSize) {
+        const auto size = std::min(FrameBatchSize, numFaces - start);
+        const auto faces = topology.face(start);
+
+        for (size_t i = 0; i < size; i++) {
+            const auto &v0 = points[faces[i * 3]];
+            const auto &v1 = points[faces[i * 3 + 1]];
+            const auto &v2 = points[faces[i * 3 + 2]];
+
+            for (auto c = 0; c < 3; c++) {
+                e0[c][i] = v1[c] - v0[c];
+                e1[c][i] = v2[c] - v0[c];
+            }
+        }
+
+        // n = (e0 x e1).normalized(); zero for collinear edges
+        for (size_t i = 0; i < size; i++) {
+            const auto x = e0[1][i] * e1[2][i] - e0[2][i] * e1[1][i];
+            const auto y = e0[2][i] * e1[0][i] - e0[0][i] * e1[2][i];
+            const auto z = e0[0][i] * e1[1][i] - e0[1][i] * e1[0][i];
+
+            const auto sqNorm = x * x + y * y + z * z;
+            const auto norm = std::sqrt(sqNorm);
+
+            singular[i] = !(sqNorm > 0.0);
+
+            n[0][i] = singular[i] ? x : x / norm;
+            n[1][i] = singular[i] ? y : y / norm;
+            n[2][i] = singular[i] ? z : z / norm;
+
+            // Edges that are zero (to Eigen's isZero precision) give a zero frame
+            auto maxEdge = 0.0;
+            for (auto c = 0; c < 3; c++) {
+                maxEdge = std::max(maxEdge, std::max(std::abs(e0[c][i]), std::abs(e1[c][i])));
+            }
+
+            zero[i] = maxEdge <= Eigen::NumTraits<double>::dummy_precision();
+        }
+
+        if (invFrames != nullptr) {
+            // Cofactor inverse, in the same order of operations as Eigen's 3x3 inverse
+            // m(r, c) is column c of the frame: e0, e1, n
+            for (size_t i = 0; i < size; i++) {
+                const double m[3][3] = {
+                        {e0[0][i], e1[0][i], n[0][i]},
+                        {e0[1][i], e1[1][i], n[1][i]},
+                        {e0[2][i], e1[2][i], n[2][i]}
+                };
+
+                double cofactor[3][3];
+                for (auto r = 0; r < 3; r++) {
+                    for (auto c = 0; c < 3; c++) {
+                        const auto r1 = (r + 1) % 3, r2 = (r + 2) % 3;
+                        const auto c1 = (c + 1) % 3, c2 = (c + 2) % 3;
+
+                        cofactor[r][c] = m[r1][c1] * m[r2][c2] - m[r1][c2] * m[r2][c1];
+                    }
+                }
+
+                const auto det = cofactor[0][0] * m[0][0] + cofactor[1][0] * m[1][0] + cofactor[2][0] * m[2][0];
+                const auto invDet = 1.0 / det;
+
+                // Singular frames get a zero inverse rather than infinities
+                const auto scale = singular[i] || zero[i] ? 0.0 : invDet;
+
+                for (auto r = 0; r < 3; r++) {
+                    for (auto c = 0; c < 3; c++) {
+                        inv[r + c * 3][i] = cofactor[c][r] * scale;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < size; i++) {
+            auto &frame = frames[start + i];
+
+            if (zero[i]) {
+                frame.setZero();
+            } else {
+                frame << e0[0][i], e1[0][i], n[0][i],
+                        e0[1][i], e1[1][i], n[1][i],
+                        e0[2][i], e1[2][i], n[2][i];
+            }
+
+            if (invFrames != nullptr) {
+                auto &invFrame = (*invFrames)[start + i];
+
+                for (auto j = 0; j < 9; j++) {
+                    invFrame.data()[j] = inv[j][i];
+                }
+            }
+
+            if (zero[i] || singular[i])
+                numDegenerate++;
+        }
+    }
+
+    return numDegenerate;
+}
+
+size_t CalculateFrames(MeshPtr mesh, const Topology &topology, TensorView<Matrix3x3> frames) {
+    return CalculateFrames(mesh, topology, frames, nullptr);
+}
+
+size_t CalculateFrames(MeshPtr mesh, const Topology &topology, TensorView<Matrix3x3> frames,
+                       TensorView<Matrix3x3> invFrames) {
+    return CalculateFrames(mesh, topology, frames, &invFrames);
+}
+
+void GenerateEmptyFrames(MeshPtr mesh, TensorView<Matrix3x3> gradients) {
+    for (auto i = 0; i < gradients.size(); i++) {
+        gradients[i].setZero();
+    }
+}
@@ -11,6 +11,7 @@
 
 #include "Mesh.h"
 #include "Matrix.h"
+#include "Tensor.h"
 
 void CalculateSurface(const Mesh &ref, const Mesh::FaceHandle &refFace, Matrix3x3 &s);
 
@@ -24,4 +25,16 @@ void CalculateInvFrames(MeshPtr mesh, std::vector<Matrix3x3> &gradients);
 
 void GenerateEmptyFrames(MeshPtr, std::vector<Matrix3x3> &gradients);
 
+// Frames (and inverse frames) of every face, into a tensor's shape that must
+// already have a frame per face. The mesh must have the topology's connectivity.
+// Faces are processed in batches gathered into SoA arrays, so the frame and
+// cofactor inverse loops vectorize. Degenerate faces (zero edges, or collinear)
+// are counted and returned; their inverse frames are zero.
+size_t CalculateFrames(MeshPtr mesh, const Topology &topology, TensorView<Matrix3x3> frames);
+
+size_t CalculateFrames(MeshPtr mesh, const Topology &topology, TensorView<Matrix3x3> frames,
+                       TensorView<Matrix3x3> invFrames);
+
+void GenerateEmptyFrames(MeshPtr mesh, TensorView<Matrix3x3> gradients);
+
 #endif /* SolverUtil_hpp */
@@ -0,0 +1,127 @@
+//
+//  Tensor.hpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#ifndef Tensor_hpp
+#define Tensor_hpp
+
+#include <cstddef>
+#include <vector>
+
+// Order of the values in a Tensor's block
+//   FaceMajor:  every shape of face 0, then face 1, ... (per-face solves)
+//   ShapeMajor: every face of shape 0, then shape 1, ... (per-shape solves)
+enum class TensorLayout {
+    FaceMajor,
+    ShapeMajor
+};
+
+// Strided view of a Tensor; the faces of one shape or the shapes of one face
+template<typename T>
+class TensorView {
+public:
+    TensorView(T *data, size_t size, size_t stride)
+            : _data(data)
+            , _size(size)
+            , _stride(stride) {
+    }
+
+    T &operator[](size_t i) const { return _data[i * _stride]; }
+
+    size_t size() const { return _size; }
+
+    bool isContiguous() const { return _stride == 1; }
+
+    T *data() const { return _data; }
+
+private:
+    T *_data;
+
+    size_t _size;
+    size_t _stride;
+};
+
+// Per-face values for a number of shapes (blendshapes or poses), stored in a
+// single block. tensor[shape][face] reads as the nested vectors it replaces.
+template<typename T>
+class Tensor {
+public:
+    explicit Tensor(TensorLayout layout = TensorLayout::FaceMajor)
+            : _layout(layout)
+            , _numShapes(0)
+            , _numFaces(0) {
+    }
+
+    TensorLayout layout() const { return _layout; }
+
+    size_t numShapes() const { return _numShapes; }
+
+    size_t numFaces() const { return _numFaces; }
+
+    size_t size() const { return _values.size(); }
+
+    bool empty() const { return _values.empty(); }
+
+    // Values are kept when the dimensions don't change, otherwise value-initialized
+    void resize(size_t numShapes, size_t numFaces) {
+        if (numShapes == _numShapes && numFaces == _numFaces)
+            return;
+
+        _numShapes = numShapes;
+        _numFaces = numFaces;
+
+        _values.assign(numShapes * numFaces, T());
+    }
+
+    T &operator()(size_t shape, size_t face) { return _values[index(shape, face)]; }
+
+    const T &operator()(size_t shape, size_t face) const { return _values[index(shape, face)]; }
+
+    TensorView<T> shape(size_t shape) {
+        return TensorView<T>(_values.data() + index(shape, 0), _numFaces, shapeStride());
+    }
+
+    TensorView<const T> shape(size_t shape) const {
+        return TensorView<const T>(_values.data() + index(shape, 0), _numFaces, shapeStride());
+    }
+
+    TensorView<T> face(size_t face) {
+        return TensorView<T>(_values.data() + index(0, face), _numShapes, faceStride());
+    }
+
+    TensorView<const T> face(size_t face) const {
+        return TensorView<const T>(_values.data() + index(0, face), _numShapes, faceStride());
+    }
+
+    TensorView<T> operator[](size_t shape) { return this->shape(shape); }
+
+    TensorView<const T> operator[](size_t shape) const { return this->shape(shape); }
+
+    T *data() { return _values.data(); }
+
+    const T *data() const { return _values.data(); }
+
+private:
+    TensorLayout _layout;
+
+    size_t _numShapes;
+    size_t _numFaces;
+
+    std::vector<T> _values;
+
+    size_t index(size_t shape, size_t face) const {
+        return _layout == TensorLayout::FaceMajor ? face * _numShapes + shape : shape * _numFaces + face;
+    }
+
+    // Distance between consecutive faces of a shape
+    size_t shapeStride() const { return _layout == TensorLayout::FaceMajor ? _numShapes : 1; }
+
+    // Distance between consecutive shapes of a face
+    size_t faceStride() const { return _layout == TensorLayout::FaceMajor ? 1 : _numFaces; }
+};
+
+#endif /* Tensor_hpp */
@@ -0,0 +1,196 @@
+//
+//  blendbench.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <iostream>
+#include <random>
+
+#include "../shared/Timing.h"
+
+#include "../ebfr/Rig.h"
+#include "../ebfr/SparseBlendshapes.h"
+#include "../ebfr/QuantizedBlendshapes.h"
+
+#include <cxxopts.hpp>
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("blend-bench", "Benchmark pose evaluation over sparse weights");
+
+    options.add_options()
+            ("blendshapes", "Path to the directory containing the blendshapes", cxxopts::value<std::string>())
+            ("frames", "Number of frames to evaluate", cxxopts::value<int>()->default_value("1000"))
+            ("min-active", "Minimum number of active blendshapes per frame", cxxopts::value<int>()->default_value("5"))
+            ("max-active", "Maximum number of active blendshapes per frame", cxxopts::value<int>()->default_value("10"))
+            ("quantize", "Also benchmark quantized deltas (int16, float16)", cxxopts::value<std::string>());
+
+    std::string blendshapeDir;
+    std::string quantize;
+    int numFrames, minActive, maxActive;
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("blendshapes")) {
+            std::cout << options.help() << std::endl;
+            exit(1);
+        }
+
+        blendshapeDir = result["blendshapes"].as<std::string>();
+        numFrames = result["frames"].as<int>();
+        minActive = result["min-active"].as<int>();
+        maxActive = result["max-active"].as<int>();
+
+        if (result.count("quantize")) {
+            quantize = result["quantize"].as<std::string>();
+        }
+    }
+    catch (const cxxopts::OptionException &e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(1);
+    }
+
+    auto rig = MakeRig();
+    if (!rig->loadBlendshapes(blendshapeDir)) {
+        std::cerr << "Failed to load rig " << blendshapeDir << std::endl;
+        return 1;
+    }
+
+    const auto numShapes = (int) rig->numBlendshapes() - 1;
+
+    maxActive = std::min(maxActive, numShapes);
+    minActive = std::min(minActive, maxActive);
+
+    // Facial animation frames activate a handful of shapes,
+    // mostly at partial weights
+    std::mt19937 gen(0);
+    std::uniform_int_distribution<> count(minActive, maxActive);
+    std::normal_distribution<> value{0.5, 0.3};
+
+    std::vector<int> shapes(numShapes);
+    for (auto i = 0; i < numShapes; i++) {
+        shapes[i] = i + 1;
+    }
+
+    std::vector<Weights> frames(numFrames, Weights(rig->numBlendshapes(), 0.0));
+
+    for (auto &weights : frames) {
+        weights[0] = 1.0;
+
+        std::shuffle(shapes.begin(), shapes.end(), gen);
+
+        const auto numActive = count(gen);
+        for (auto i = 0; i < numActive; i++) {
+            weights[shapes[i]] = std::clamp(value(gen), 0.05, 1.0);
+        }
+    }
+
+    SparseBlendshapes sparse;
+    sparse.build(*rig);
+
+    size_t totalSupport = 0;
+    for (auto bs = 1; bs < sparse.numBlendshapes(); bs++) {
+        totalSupport += sparse.support(bs).size();
+    }
+
+    std::cout
+            << "Vertices: " << sparse.numVertices() << std::endl
+            << "Blendshapes: " << numShapes << std::endl
+            << "Active: " << minActive << " - " << maxActive << std::endl
+            << "Mean Support: " << (numShapes > 0 ? totalSupport / numShapes : 0) << std::endl
+            << "Frames: " << numFrames << std::endl;
+
+    double checksum = 0.0;
+
+    // Mesh copy + AddVertices for every blendshape
+    TIMER_START(AddVertices);
+
+    auto mesh = MakeMesh(rig->neutral());
+
+    for (const auto &weights : frames) {
+        CopyVertices(mesh, rig->neutral());
+
+        for (auto bs = 1; bs < rig->numBlendshapes(); bs++) {
+            AddVertices(mesh, rig->blendshape(bs).mesh(), weights[bs]);
+        }
+
+        checksum += mesh->point(mesh->vertex_handle(0))[0];
+    }
+
+    TIMER_END(AddVertices);
+
+    // Dense GEMV
+    VectorX dense;
+
+    TIMER_START(Dense);
+
+    for (const auto &weights : frames) {
+        rig->evaluate(weights, dense);
+
+        checksum += dense(0);
+    }
+
+    TIMER_END(Dense);
+
+    // Active shapes and vertex support only
+    VectorX points;
+    size_t touched = 0;
+
+    TIMER_START(Sparse);
+
+    for (const auto &weights : frames) {
+        sparse.evaluate(weights, points);
+
+        touched += sparse.numTouched();
+        checksum += points(0);
+    }
+
+    TIMER_END(Sparse);
+
+    double maxError = 0.0;
+
+    for (const auto &weights : frames) {
+        rig->evaluate(weights, dense);
+        sparse.evaluate(weights, points);
+
+        maxError = std::max(maxError, (dense - points).cwiseAbs().maxCoeff());
+    }
+
+    if (!quantize.empty()) {
+        const auto format = quantize == "float16" ? QuantizedBlendshapes::Float16 : QuantizedBlendshapes::Int16;
+
+        QuantizedBlendshapes quantized(format);
+        quantized.build(*rig);
+
+        Eigen::VectorXf qPoints;
+
+        TIMER_START(Quantized);
+
+        for (const auto &weights : frames) {
+            quantized.evaluate(weights, qPoints);
+
+            checksum += qPoints(0);
+        }
+
+        TIMER_END(Quantized);
+
+        const auto deltaError = quantized.error(*rig);
+        const auto poseError = quantized.error(*rig, frames);
+
+        std::cout
+                << "Quantized (" << FormatName(format) << "): "
+                << quantized.sizeInBytes() << " / " << (rig->deltas().size() * sizeof(double)) << " bytes" << std::endl
+                << "\tDelta Error: max " << deltaError.max << ", rms " << deltaError.rms << std::endl
+                << "\tPose Error: max " << poseError.max << ", rms " << poseError.rms << std::endl;
+    }
+
+    std::cout
+            << "Mean Touched Vertices: " << (numFrames > 0 ? touched / numFrames : 0) << std::endl
+            << "Max Error (Sparse vs Dense): " << maxError << std::endl
+            << "Checksum: " << checksum << std::endl;
+
+    return 0;
+}
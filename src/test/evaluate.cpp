@@ -0,0 +1,148 @@
+//
+//  evaluate.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <iostream>
+#include <random>
+
+#include "../ebfr/Rig.h"
+
+#include <cxxopts.hpp>
+
+// A pose is the neutral plus the weighted blendshape deltas, N + sum_(b>=1) w_b * D_b.
+// The neutral/BS0 weight doesn't contribute; the debug pose output used to add
+// w_0 * N on top, which scaled the whole face by 1 + w_0.
+VectorX ExpectedPose(const Rig &rig, const Weights &weights) {
+    const auto numV = rig.neutral()->n_vertices();
+
+    VectorX points(numV * 3);
+    CopyVertices(points.data(), rig.neutral());
+
+    for (auto bs = 1; bs < rig.numBlendshapes(); bs++) {
+        const auto *deltas = rig.blendshape(bs).mesh()->points();
+
+        for (auto v = 0; v < numV; v++) {
+            for (auto i = 0; i < 3; i++) {
+                points[v * 3 + i] += weights[bs] * deltas[v][i];
+            }
+        }
+    }
+
+    return points;
+}
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("test-evaluate", "Check the rig's pose evaluation against the blendshape meshes");
+
+    options.add_options()
+            ("blendshapes", "Path to the directory containing the blendshapes", cxxopts::value<std::string>())
+            ("num", "Number of random poses to evaluate", cxxopts::value<int>()->default_value("16"));
+
+    std::string blendshapeDir;
+    int numPoses;
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("blendshapes")) {
+            std::cout << options.help() << std::endl;
+            exit(1);
+        }
+
+        blendshapeDir = result["blendshapes"].as<std::string>();
+        numPoses = std::max(1, result["num"].as<int>());
+    }
+    catch (const cxxopts::OptionException &e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(1);
+    }
+
+    auto rig = MakeRig();
+    if (!rig->loadBlendshapes(blendshapeDir)) {
+        std::cerr << "Failed to load rig " << blendshapeDir << std::endl;
+        return 1;
+    }
+
+    std::mt19937 g(0);
+    std::uniform_real_distribution<> u(0.0, 1.0);
+
+    std::vector<Weights> poses(numPoses, Weights(rig->numBlendshapes()));
+
+    for (auto &weights : poses) {
+        for (auto &w : weights) {
+            w = u(g);
+        }
+    }
+
+    const double tolerance = 1e-9;
+
+    double maxError = 0.0;
+    size_t numFailed = 0;
+
+    auto check = [&](const std::string &name, int pose, const VectorX &expected, const VectorX &points) {
+        const auto error = (points - expected).lpNorm<Eigen::Infinity>() / std::max(1.0, expected.lpNorm<Eigen::Infinity>());
+
+        maxError = std::max(maxError, error);
+
+        if (error > tolerance) {
+            std::cout << "Pose " << pose << " (" << name << "): error " << error << std::endl;
+            numFailed++;
+        }
+    };
+
+    MatrixX batch;
+    rig->evaluate(poses, batch);
+
+    // The same poses as contiguous rows without the neutral weight, as read from a PoseTable
+    std::vector<double> rows;
+
+    for (const auto &weights : poses) {
+        rows.insert(rows.end(), weights.begin() + 1, weights.end());
+    }
+
+    MatrixX contiguous;
+    rig->evaluate(rows.data(), numPoses, contiguous);
+
+    const auto meshes = rig->generatePoses(poses);
+
+    for (auto i = 0; i < numPoses; i++) {
+        const auto expected = ExpectedPose(*rig, poses[i]);
+
+        VectorX points;
+        rig->evaluate(poses[i], points);
+
+        check("evaluate", i, expected, points);
+        check("batch", i, expected, batch.col(i));
+        check("contiguous", i, expected, contiguous.col(i));
+
+        VectorX meshPoints(expected.size());
+        CopyVertices(meshPoints.data(), meshes[i]);
+
+        check("generatePoses", i, expected, meshPoints);
+
+        // Changing the neutral weight mustn't move the pose
+        auto weights = poses[i];
+        weights[0] = 0.0;
+
+        rig->evaluate(weights, points);
+
+        check("neutral weight", i, expected, points);
+    }
+
+    std::cout
+            << "Poses: " << numPoses << std::endl
+            << "Max Relative Error: " << maxError << std::endl;
+
+    if (numFailed > 0) {
+        std::cout << "FAIL - " << numFailed << " evaluations differ from the blendshape meshes" << std::endl;
+        return 1;
+    }
+
+    std::cout << "PASS" << std::endl;
+
+    return 0;
+}
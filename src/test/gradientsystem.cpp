@@ -0,0 +1,304 @@
+//
+//  gradientsystem.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <iostream>
+#include <random>
+
+#include "../shared/SolverUtil.h"
+
+#include "../ebfr/Rig.h"
+#include "../ebfr/GradientSolver.h"
+
+#include "../Args.h"
+
+// The per-face system as it was assembled before the K (x) I9 split: a fit
+// row block w_(p,b) * M^B_b = S_p - N for every source pose, and a
+// regularization row block wbeta * M^B_b = wbeta * M*_b for every target pose
+// and blendshape, solved through the dense 9B x 9B normal equations
+MatrixX DenseSolve(const Rig &source, const Rig &target, const Gradients &targetGradients,
+                   const GradientSolver &solver, double beta, Index face) {
+    const Index mSize = Matrix9x1::SizeAtCompileTime;
+
+    const auto numBS = target.numBlendshapes();
+    const auto rows = (source.numPoses() * mSize) + (target.numPoses() * (numBS - 1) * mSize);
+    const auto cols = numBS * mSize;
+
+    TripletList a;
+    MatrixX c = MatrixX::Zero(rows, 1);
+
+    const auto &n = targetGradients.blendshapeM(0, face);
+
+    for (auto pose = 0; pose < source.numPoses(); pose++) {
+        const auto row = pose * mSize;
+
+        for (auto bs = 0; bs < numBS; bs++) {
+            const auto weight = target.weight(pose, bs);
+
+            if (weight == 0.0)
+                continue;
+
+            for (auto i = 0; i < mSize; i++) {
+                a.emplace_back(row + i, bs * mSize + i, weight);
+            }
+        }
+
+        const Matrix3x3 d = targetGradients.poseM(pose, face) - n;
+
+        c.block(row, 0, mSize, 1) = Eigen::Map<const Matrix9x1>(d.data());
+    }
+
+    for (auto pose = 0; pose < target.numPoses(); pose++) {
+        for (auto bs = 1; bs < numBS; bs++) {
+            const auto row = (source.numPoses() * mSize) + (((numBS - 1) * mSize * pose) + (mSize * (bs - 1)));
+            const auto wbeta = solver.w()(bs, face) * beta;
+
+            if (wbeta == 0.0)
+                continue;
+
+            for (auto i = 0; i < mSize; i++) {
+                a.emplace_back(row + i, bs * mSize + i, wbeta);
+            }
+
+            c.block(row, 0, mSize, 1) = wbeta * Eigen::Map<const Matrix9x1>(solver.mStar()(bs, face).data());
+        }
+    }
+
+    SparseMatrix A(rows, cols);
+    A.setFromTriplets(a.begin(), a.end());
+
+    const auto At = A.transpose();
+
+    Eigen::LLT<MatrixX> llt(MatrixX(At * A));
+
+    if (llt.info() != Eigen::Success)
+        return MatrixX();
+
+    return llt.solve(At * c);
+}
+
+// Compares every masked face's blendshape gradients against the dense solve,
+// returns the number that differ
+size_t CheckFaces(const Rig &source, const Rig &target, const Gradients &targetGradients,
+                  const GradientSolver &solver, double beta, double &maxError) {
+    const double tolerance = 1e-8;
+
+    const auto numBS = target.numBlendshapes();
+
+    size_t numFailed = 0;
+
+    for (auto i = 0; i < target.numFaces(); i++) {
+        const Index face = target.face(i);
+
+        const auto expected = DenseSolve(source, target, targetGradients, solver, beta, face);
+
+        if (expected.size() == 0) {
+            std::cerr << "Dense solve failed for face " << face << std::endl;
+            numFailed++;
+            continue;
+        }
+
+        for (auto bs = 1; bs < numBS; bs++) {
+            const Matrix9x1 e = expected.block(bs * 9, 0, 9, 1);
+            const Matrix9x1 r = Eigen::Map<const Matrix9x1>(targetGradients.blendshapeM(bs, face).data());
+
+            const auto error = (r - e).norm() / std::max(1.0, e.norm());
+
+            maxError = std::max(maxError, error);
+
+            if (error > tolerance) {
+                numFailed++;
+            }
+        }
+    }
+
+    return numFailed;
+}
+
+// A small random rig (a 4x4 vertex grid) with numBlendshapes - 1 shapes and a
+// target scaled from its poses. The first numActive columns are weighted in
+// the poses, the rest are zero in every one of them.
+void MakeRigs(size_t numBlendshapes, size_t numActive, size_t numPoses, RigPtr &source, RigPtr &target) {
+    const size_t size = 4;
+
+    std::mt19937 g((unsigned) (numBlendshapes * 1000 + numActive));
+    std::uniform_real_distribution<> u(0.0, 1.0);
+    std::uniform_real_distribution<> d(-0.1, 0.1);
+
+    std::vector<double> positions;
+    std::vector<int> faces;
+
+    for (auto y = 0; y < size; y++) {
+        for (auto x = 0; x < size; x++) {
+            positions.insert(positions.end(), {(double) x, (double) y, 0.2 * u(g)});
+
+            if (x + 1 < size && y + 1 < size) {
+                const int v = (int) (y * size + x);
+
+                faces.insert(faces.end(), {v, v + 1, v + (int) size + 1, v, v + (int) size + 1, v + (int) size});
+            }
+        }
+    }
+
+    const auto numV = size * size;
+    auto neutral = BuildMesh(positions.data(), numV, faces.data(), faces.size() / 3, MeshProfile::Light);
+
+    source = MakeRig();
+    source->setNeutral(neutral);
+    source->blendshapes().resize(numBlendshapes);
+
+    std::vector<double> deltas(numV * 3);
+
+    for (auto bs = 1; bs < numBlendshapes; bs++) {
+        for (auto &delta : deltas) {
+            delta = d(g);
+        }
+
+        auto mesh = MakeMesh(neutral);
+        CopyVertices(mesh, deltas.data());
+
+        source->blendshapes()[bs].setMesh(mesh, false);
+    }
+
+    source->buildDeltas();
+
+    target = MakeRig();
+
+    auto targetNeutral = MakeMesh(neutral);
+    CopyVertices(positions.data(), neutral);
+
+    for (auto &p : positions) {
+        p *= 1.2;
+    }
+
+    CopyVertices(targetNeutral, positions.data());
+    target->setNeutral(targetNeutral);
+
+    for (auto pose = 0; pose < numPoses; pose++) {
+        Weights weights(numBlendshapes, 0.0);
+        weights[0] = 1.0;
+
+        for (auto bs = 1; bs < numActive; bs++) {
+            weights[bs] = u(g);
+        }
+
+        auto mesh = source->generatePose(weights);
+        source->poses().emplace_back(mesh, weights);
+
+        auto targetMesh = MakeMesh(mesh);
+        CopyVertices(positions.data(), mesh);
+
+        for (auto &p : positions) {
+            p = 1.2 * p + 0.1 * d(g);
+        }
+
+        CopyVertices(targetMesh, positions.data());
+        target->poses().emplace_back(targetMesh, weights);
+    }
+
+    target->generateEmptyBlendshapes(numBlendshapes);
+}
+
+// Solves a synthetic rig, checks the kernel instance the solve ran and the
+// result against the dense solve
+size_t CheckSynthetic(size_t numBlendshapes, size_t numActive, int expectedKernel) {
+    const double beta = 0.5;
+
+    RigPtr sourceRig, targetRig;
+    MakeRigs(numBlendshapes, numActive, 64, sourceRig, targetRig);
+
+    auto sourceGradients = std::make_shared<Gradients>();
+
+    auto targetGradients = std::make_shared<Gradients>();
+    targetGradients->calculate(targetRig, true);
+
+    GradientSolver solver;
+    solver.setBlendshapeSolveConsts(beta);
+    solver.setSource(sourceRig, sourceGradients);
+    solver.setTarget(targetRig, targetGradients);
+    solver.init();
+
+    if (!solver.solve(0)) {
+        std::cerr << "Gradient solve failed" << std::endl;
+        return 1;
+    }
+
+    size_t numFailed = 0;
+
+    if (solver.kernelSize() != expectedKernel) {
+        std::cout << "Kernel: " << solver.kernelSize() << ", expected " << expectedKernel << std::endl;
+        numFailed++;
+    }
+
+    double maxError = 0.0;
+    numFailed += CheckFaces(*sourceRig, *targetRig, *targetGradients, solver, beta, maxError);
+
+    std::cout
+            << "Synthetic " << numActive - 1 << " / " << numBlendshapes - 1 << " Blendshapes" << std::endl
+            << "Max Relative Error: " << maxError << std::endl;
+
+    return numFailed;
+}
+
+int main(int argc, char *argv[]) {
+    size_t numFailed = 0;
+
+    // Expects the default EBFR_FIXED_BLENDSHAPES (53, 151). Inactive columns
+    // pad the system up to the next fixed size that fits in the rig.
+    numFailed += CheckSynthetic(53, 53, 53);
+    numFailed += CheckSynthetic(53, 20, 53);
+    numFailed += CheckSynthetic(60, 50, 53);
+    numFailed += CheckSynthetic(60, 60, Eigen::Dynamic);
+
+    // The rig from the data files, when they're given
+    if (argc > 1) {
+        const double beta = 0.5;
+
+        Args args;
+        args.read(argc, argv);
+
+        auto sourceRig = MakeRig();
+        sourceRig->load(args.srcBlendshapeDir, args.srcPoseDir, args.srcWeightsPath, args.vertexMaskPath, false);
+
+        auto targetRig = MakeRig();
+        targetRig->load(args.tgtNeutralPath, args.tgtPoseDir, args.tgtWeightsPath, args.vertexMaskPath, true);
+
+        targetRig->generateEmptyBlendshapes(sourceRig->numBlendshapes());
+
+        auto sourceGradients = std::make_shared<Gradients>();
+
+        auto targetGradients = std::make_shared<Gradients>();
+        targetGradients->calculate(targetRig, true);
+
+        GradientSolver solver;
+        solver.setBlendshapeSolveConsts(beta);
+        solver.setSource(sourceRig, sourceGradients);
+        solver.setTarget(targetRig, targetGradients);
+        solver.init();
+
+        if (!solver.solve(0)) {
+            std::cerr << "Gradient solve failed" << std::endl;
+            return 1;
+        }
+
+        double maxError = 0.0;
+        numFailed += CheckFaces(*sourceRig, *targetRig, *targetGradients, solver, beta, maxError);
+
+        std::cout
+                << "Faces: " << targetRig->numFaces() << std::endl
+                << "Max Relative Error: " << maxError << std::endl;
+    }
+
+    if (numFailed > 0) {
+        std::cout << "FAIL - " << numFailed << " checks differ from the dense solve or fixed kernel" << std::endl;
+        return 1;
+    }
+
+    std::cout << "PASS" << std::endl;
+
+    return 0;
+}
@@ -85,13 +85,19 @@ int main(int argc, char *argv[]) {
 
         auto rig = MakeRig();
 
-        rig->loadBlendshapes(blendshapeDir);
+        if (!rig->loadBlendshapes(blendshapeDir)) {
+            std::cerr << "Failed to load rig " << blendshapeDir << std::endl;
+            return 1;
+        }
 
         rigs.push_back(rig);
     }
 
     std::vector<double> weights(rigs[0]->numBlendshapes() - 1);
 
+    // Rig weights include the neutral/BS0 entry
+    std::vector<Weights> poses(numPoses, Weights(rigs[0]->numBlendshapes(), 0.0));
+
     std::ofstream poseWeights;
     poseWeights.open(outputPath + "/random.csv", std::ofstream::out | std::ofstream::app);
 
@@ -141,8 +147,18 @@ int main(int argc, char *argv[]) {
             poseWeights << w << ",";
         }
 
-        for (auto r = 0; r < rigs.size(); r++) {
-            auto pose = rigs[r]->generatePose(weights);
+        poses[i][0] = 1.0;
+        std::copy(weights.begin(), weights.end(), poses[i].begin() + 1);
+    }
+
+    for (auto r = 0; r < rigs.size(); r++) {
+        auto pose = MakeMesh(rigs[r]->neutral());
+
+        MatrixX points;
+        rigs[r]->evaluate(poses, points);
+
+        for (auto i = 0; i < numPoses; i++) {
+            CopyVertices(pose, points.col(i).data());
 
             WriteMesh(outputPath + "/" + std::to_string(r) + "/" + std::to_string(i) + ".obj", pose);
         }
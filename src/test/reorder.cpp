@@ -0,0 +1,214 @@
+//
+//  reorder.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <numeric>
+#include <random>
+
+#include "../shared/Reorder.h"
+#include "../shared/SolverUtil.h"
+#include "../shared/Tensor.h"
+
+#include "../ebfr/Rig.h"
+
+#include <cxxopts.hpp>
+
+typedef std::chrono::high_resolution_clock Clock;
+
+template<typename Op>
+double TimeStage(int repeats, const Op &op) {
+    const auto start = Clock::now();
+
+    for (auto i = 0; i < repeats; i++) {
+        op();
+    }
+
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+}
+
+// Scanned meshes come in arbitrary order; a random permutation stands in for one
+Reordering ShuffledReordering(const Rig &rig) {
+    std::mt19937 g(0);
+
+    std::vector<int> vertexOrder(rig.numVertices(true));
+    std::iota(vertexOrder.begin(), vertexOrder.end(), 0);
+    std::shuffle(vertexOrder.begin(), vertexOrder.end(), g);
+
+    std::vector<int> faceOrder(rig.numFaces(true));
+    std::iota(faceOrder.begin(), faceOrder.end(), 0);
+    std::shuffle(faceOrder.begin(), faceOrder.end(), g);
+
+    return Reordering(vertexOrder, faceOrder);
+}
+
+// The vertex solver's system: the neutral's inverse frames applied to each face's edges
+void ConstructSystem(const Rig &rig, SparseMatrix &ata) {
+    const auto &topology = *rig.topology();
+
+    Tensor<Matrix3x3> frames, invFrames;
+    frames.resize(1, topology.numFaces());
+    invFrames.resize(1, topology.numFaces());
+
+    CalculateFrames(rig.neutral(), topology, frames[0], invFrames[0]);
+
+    TripletList m;
+    m.reserve(topology.numFaces() * 36);
+
+    for (auto f = 0; f < topology.numFaces(); f++) {
+        const auto face = topology.face(f);
+        const auto &mInv = invFrames(0, f);
+
+        for (int coord = 0; coord < 3; coord++) {
+            for (int eqn = 0; eqn < 3; eqn++) {
+                const auto row = f * 9 + coord * 3 + eqn;
+
+                m.emplace_back(row, face[0] * 3 + coord, -mInv(0, eqn) - mInv(1, eqn));
+                m.emplace_back(row, face[1] * 3 + coord, mInv(0, eqn));
+                m.emplace_back(row, face[2] * 3 + coord, mInv(1, eqn));
+            }
+        }
+    }
+
+    // Pin one vertex so the system is definite
+    const auto rows = topology.numFaces() * 9;
+    for (auto coord = 0; coord < 3; coord++) {
+        m.emplace_back(rows + coord, coord, 1.0);
+    }
+
+    SparseMatrix a(rows + 3, rig.numVertices(true) * 3);
+    a.setFromTriplets(m.begin(), m.end());
+
+    ata = a.transpose() * a;
+}
+
+struct StageTimes {
+    double addVertices;
+    double evaluate;
+    double frames;
+    double factorize;
+    double factorizeNatural;
+    size_t fill;
+    size_t fillNatural;
+};
+
+StageTimes Benchmark(const Rig &rig, int repeats) {
+    StageTimes times = {};
+
+    auto neutral = rig.neutral();
+    auto temp = MakeMesh(neutral);
+
+    times.addVertices = TimeStage(repeats, [&]() {
+        for (auto bs = 1; bs < rig.numBlendshapes(); bs++) {
+            AddVertices(rig.blendshape(bs).mesh(), neutral, -1, temp);
+        }
+    });
+
+    Weights weights(rig.numBlendshapes(), 0.5);
+    VectorX points;
+
+    times.evaluate = TimeStage(repeats, [&]() {
+        rig.evaluate(weights, points);
+    });
+
+    Tensor<Matrix3x3> frames;
+    frames.resize(rig.numBlendshapes(), rig.numFaces(true));
+
+    times.frames = TimeStage(repeats, [&]() {
+        for (auto bs = 0; bs < rig.numBlendshapes(); bs++) {
+            CalculateFrames(rig.blendshape(bs).mesh(), *rig.topology(), frames[bs]);
+        }
+    });
+
+    SparseMatrix ata;
+    ConstructSystem(rig, ata);
+
+    // As the vertex solver (AMD ordering), and without a fill-reducing ordering
+    Eigen::SimplicialLDLT<SparseMatrix> solver;
+    times.factorize = TimeStage(1, [&]() { solver.compute(ata); });
+    times.fill = solver.matrixL().nestedExpression().nonZeros();
+
+    Eigen::SimplicialLDLT<SparseMatrix, Eigen::Lower, Eigen::NaturalOrdering<int>> natural;
+    times.factorizeNatural = TimeStage(1, [&]() { natural.compute(ata); });
+    times.fillNatural = natural.matrixL().nestedExpression().nonZeros();
+
+    return times;
+}
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("test-reorder", "Benchmark the solver stages with the original, shuffled and Morton vertex orders");
+
+    options.add_options()
+            ("blendshapes", "Path to the directory containing the blendshapes", cxxopts::value<std::string>())
+            ("repeats", "Number of times to run each per-vertex stage", cxxopts::value<int>()->default_value("20"));
+
+    std::string blendshapeDir;
+    int repeats;
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("blendshapes")) {
+            std::cout << options.help() << std::endl;
+            exit(1);
+        }
+
+        blendshapeDir = result["blendshapes"].as<std::string>();
+        repeats = std::max(1, result["repeats"].as<int>());
+    }
+    catch (const cxxopts::OptionException &e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(1);
+    }
+
+    auto rig = MakeRig();
+    if (!rig->loadBlendshapes(blendshapeDir)) {
+        std::cerr << "Failed to load rig " << blendshapeDir << std::endl;
+        return 1;
+    }
+
+    std::cout
+            << "Vertices: " << rig->numVertices(true) << std::endl
+            << "Faces: " << rig->numFaces(true) << std::endl
+            << "Blendshapes: " << rig->numBlendshapes() - 1 << std::endl
+            << std::endl;
+
+    const auto original = Benchmark(*rig, repeats);
+
+    rig->reorder(ShuffledReordering(*rig));
+
+    const auto shuffled = Benchmark(*rig, repeats);
+
+    rig->reorder(MortonReordering(rig->neutral(), *rig->topology()));
+
+    const auto morton = Benchmark(*rig, repeats);
+
+    auto printRow = [](const std::string &name, double a, double b, double c) {
+        std::cout << std::left << std::setw(24) << name << std::right
+                  << std::setw(12) << a << std::setw(12) << b << std::setw(12) << c << std::endl;
+    };
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    std::cout << std::left << std::setw(24) << "Stage (ms)" << std::right
+              << std::setw(12) << "Original" << std::setw(12) << "Shuffled" << std::setw(12) << "Morton" << std::endl;
+
+    printRow("AddVertices", original.addVertices, shuffled.addVertices, morton.addVertices);
+    printRow("Evaluate", original.evaluate, shuffled.evaluate, morton.evaluate);
+    printRow("Frames", original.frames, shuffled.frames, morton.frames);
+    printRow("Factorize (AMD)", original.factorize, shuffled.factorize, morton.factorize);
+    printRow("Factorize (natural)", original.factorizeNatural, shuffled.factorizeNatural, morton.factorizeNatural);
+
+    std::cout << std::setprecision(0);
+
+    printRow("L non-zeros (AMD)", original.fill, shuffled.fill, morton.fill);
+    printRow("L non-zeros (natural)", original.fillNatural, shuffled.fillNatural, morton.fillNatural);
+
+    return 0;
+}
@@ -96,14 +96,14 @@ int main(int argc, char *argv[]) {
 
     for (auto i = 0; i < sourceRig->numBlendshapes(); i++) {
         const auto mesh = sourceRig->blendshape(i).mesh();
-        auto &m = target->blendshapeM[i];
+        auto m = target->blendshapeM[i];
 
         if (i == 0) {
-            CalculateFrames(mesh, m);
+            CalculateFrames(mesh, *sourceRig->topology(), m);
         } else {
             AddVertices(mesh, neutral, 1, btemp);
 
-            CalculateFrames(btemp, m);
+            CalculateFrames(btemp, *sourceRig->topology(), m);
 
             const auto &neutralM = target->blendshapeM[0];
 
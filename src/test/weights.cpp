@@ -32,14 +32,11 @@ void onWeightsStep(int iter, RigPtr rig, const std::string &dir) {
     const std::string path = dir + "/pose-" + std::to_string(iter) + "-";
     const std::string ext = ".obj";
 
-    for (auto pose = 0; pose < rig->numPoses(); pose++) {
-        const auto &weights = rig->weights(pose);
-
-        CopyVertices(temp, rig->neutral());
+    MatrixX points;
+    rig->evaluate(rig->weights(), points);
 
-        for (auto bs = 0; bs < rig->numBlendshapes(); bs++) {
-            AddVertices(temp, rig->blendshape(bs).mesh(), weights[bs]);
-        }
+    for (auto pose = 0; pose < rig->numPoses(); pose++) {
+        CopyVertices(temp, points.col(pose).data());
 
         WriteMesh(path + std::to_string(pose) + ext, temp);
     }
@@ -127,6 +124,8 @@ int main(int argc, char *argv[]) {
         targetRig->blendshape(i).setMesh(sourceRig->blendshape(i).mesh());
     }
 
+    targetRig->buildDeltas();
+
     solver.testWeights(0);
 
     solver.testWeights(1);
@@ -0,0 +1,178 @@
+//
+//  track.cpp
+//  ExampleBasedFacialRigging
+//
+//  Created by Kyle on 5/1/21.
+//  Copyright © 2021 Kyle. All rights reserved.
+//
+
+#include <iostream>
+#include <chrono>
+
+#include "shared/FS.h"
+#include "shared/CSV.h"
+#include "shared/Parallel.h"
+
+#include "ebfr/Rig.h"
+#include "ebfr/WeightsSolver.h"
+
+#include <cxxopts.hpp>
+
+int main(int argc, char *argv[]) {
+    cxxopts::Options options("ebfr-track", "Fit per-frame blendshape weights to a sequence of scans");
+
+    options.add_options()
+            ("blendshapes", "Path to the directory containing the rig's blendshapes", cxxopts::value<std::string>())
+            ("neutral", "Path to the neutral mesh, if not [blendshapes]/neutral.obj", cxxopts::value<std::string>())
+            ("scans", "Path to the directory containing the scan (OBJ) sequence", cxxopts::value<std::string>())
+            ("output", "Path to write the per-frame weights file", cxxopts::value<std::string>())
+            ("smoothing", "Weight of the temporal smoothing term (0 to disable)", cxxopts::value<double>()->default_value("0"))
+            ("window", "Number of frames loaded and solved at a time", cxxopts::value<int>()->default_value("64"));
+
+    std::string blendshapeDir;
+    std::string neutralPath;
+    std::string scanDir;
+    std::string outputPath;
+    double smoothing;
+    size_t windowSize;
+
+    try {
+        auto result = options.parse(argc, argv);
+
+        if (!result.count("blendshapes") || !result.count("scans") || !result.count("output")) {
+            std::cout << options.help() << std::endl;
+            exit(1);
+        }
+
+        blendshapeDir = result["blendshapes"].as<std::string>();
+        scanDir = result["scans"].as<std::string>();
+        outputPath = result["output"].as<std::string>();
+        smoothing = result["smoothing"].as<double>();
+        windowSize = std::max(1, result["window"].as<int>());
+
+        if (result.count("neutral")) {
+            neutralPath = result["neutral"].as<std::string>();
+        }
+    }
+    catch (const cxxopts::OptionException &e) {
+        std::cout << "error parsing options: " << e.what() << std::endl;
+        exit(1);
+    }
+
+    auto rig = MakeRig();
+
+    const auto loaded = neutralPath.empty()
+                        ? rig->loadBlendshapes(blendshapeDir)
+                        : rig->loadBlendshapes(blendshapeDir, neutralPath);
+
+    if (!loaded) {
+        std::cerr << "Failed to load rig " << blendshapeDir << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> scanPaths;
+    ListFiles(JoinPath(scanDir, ".*\\.obj"), scanPaths);
+
+    if (scanPaths.empty()) {
+        std::cerr << "No scans found in " << scanDir << std::endl;
+        return 1;
+    }
+
+    std::cout
+            << "Scans: " << scanPaths.size() << std::endl
+            << "Blendshapes: " << (rig->numBlendshapes() - 1) << std::endl;
+
+    WeightsSolver solver;
+    solver.setTarget(rig, nullptr);
+    solver.initTracking();
+
+    PoseCSVWriter csv;
+    if (!csv.open(outputPath, rig->numBlendshapes() - 1)) {
+        std::cerr << "Failed to open " << outputPath << std::endl;
+        return 1;
+    }
+
+    const auto numWeights = (Eigen::Index) rig->numBlendshapes() - 1;
+
+    // The last solved frame; seeds the first frame of the next window
+    VectorX previous = VectorX::Zero(numWeights);
+
+    std::vector<MeshPtr> scans;
+    std::vector<VectorX> results;
+    std::vector<double> weights(numWeights);
+
+    size_t numFailed = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (size_t windowStart = 0; windowStart < scanPaths.size(); windowStart += windowSize) {
+        const auto windowEnd = std::min(windowStart + windowSize, scanPaths.size());
+        const auto size = windowEnd - windowStart;
+
+        scans.assign(size, nullptr);
+        results.assign(size, previous);
+
+        // Scans in correspondence share the rig's topology; others fall back to a (serialized) full read
+        ParallelForEach(size, [&](size_t i) {
+            scans[i] = ReadMesh(scanPaths[windowStart + i], rig->topology(), false);
+        });
+
+        auto isValid = [&](size_t i) {
+            return scans[i] != nullptr && scans[i]->n_vertices() == rig->neutral()->n_vertices();
+        };
+
+        // Each thread solves a contiguous run of frames, warm starting from
+        // the frame before. With smoothing, the prior of each frame is the
+        // solved frame before it, so the window is solved in order instead.
+        ParallelSegments(size, [&](int threadId, size_t frameStart, size_t frameEnd) {
+            VectorX x = previous;
+
+            // Without smoothing a frame's solution doesn't depend on its
+            // prior, so the last valid frame before the run is solved
+            // again here rather than waiting on the thread that owns it
+            for (auto i = frameStart; i-- > 0;) {
+                if (isValid(i)) {
+                    solver.track(scans[i], x, 0.0, x);
+                    break;
+                }
+            }
+
+            for (auto i = frameStart; i < frameEnd; i++) {
+                const VectorX prior = x;
+
+                if (!isValid(i) || !solver.track(scans[i], prior, smoothing, x)) {
+                    x = prior;
+                }
+
+                results[i] = x;
+            }
+        }, smoothing > 0.0 ? 1 : 0);
+
+        for (auto i = 0; i < size; i++) {
+            if (!isValid(i)) {
+                std::cerr << "Skipping " << scanPaths[windowStart + i] << std::endl;
+                numFailed++;
+            }
+
+            std::copy(results[i].data(), results[i].data() + numWeights, weights.begin());
+
+            csv.write(Filename(scanPaths[windowStart + i], false), weights);
+        }
+
+        previous = results.back();
+
+        std::cout << "\t" << windowEnd << " / " << scanPaths.size() << std::endl;
+    }
+
+    csv.close();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    const auto seconds = std::chrono::duration<double>(end - start).count();
+
+    std::cout
+            << "Frames: " << scanPaths.size() << " (" << numFailed << " skipped)" << std::endl
+            << "Time: " << seconds << "s" << std::endl
+            << "FPS: " << (seconds > 0.0 ? scanPaths.size() / seconds : 0.0) << std::endl;
+
+    return 0;
+}